@@ -0,0 +1,28 @@
+#ifndef _BACKOFF_H
+#define _BACKOFF_H
+
+#include <Arduino.h>
+
+/**
+ * Exponential backoff with full jitter: after n failures the delay is drawn uniformly from
+ * [0, min(maxMs, minMs * 2^n)], so that a fleet of nodes losing the same broker spreads its
+ * reconnect attempts instead of retrying in lockstep. The caller supplies the random value, e.g.
+ * esp_random(), which keeps the class deterministic on the host.
+ */
+class Backoff {
+public:
+  Backoff(uint32_t minMs, uint32_t maxMs);
+
+  // delay before the next attempt, counts a failure
+  uint32_t nextDelay(uint32_t random);
+  void reset();
+
+  uint16_t getFailures();
+
+private:
+  uint32_t minMs;
+  uint32_t maxMs;
+  uint16_t failures;
+};
+
+#endif
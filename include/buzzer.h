@@ -22,13 +22,17 @@ private:
   const uint8_t DARK_RED_BUZZES = 3;
 
   volatile uint8_t buzzCtr = 0;
+  // beeps are played by beepTicker so update() doesn't block, each beep is two 50ms steps
+  volatile uint8_t beepSteps = 0;
 
 
   void timer();
+  void beepStep();
 
   Model* model;
   uint8_t buzzerPin;
   Ticker* cyclicTimer;
+  Ticker* beepTicker;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef _COMMAND_TABLE_H
+#define _COMMAND_TABLE_H
+
+#include <Arduino.h>
+
+typedef enum {
+  CA_NONE = 0,    // payload is ignored
+  CA_INT,         // signed decimal
+  CA_UINT,        // unsigned decimal
+  CA_FLOAT,
+  CA_PAYLOAD,     // zero terminated payload is handed to the handler
+  CA_RAW          // payload is handed over in place, not copied and not zero terminated
+} CommandArgType;
+
+typedef enum {
+  CE_INLINE = 0,  // quick, runs right away on the mqtt task
+  CE_WORKER       // may block, runs on the command worker task
+} CommandExecution;
+
+typedef enum {
+  CR_OK = 0,
+  CR_UNKNOWN,
+  CR_INVALID,
+  CR_OUT_OF_RANGE,
+  CR_TOO_LONG,
+  CR_QUEUED,
+  CR_BUSY,
+  CR_FAILED
+} CommandResult;
+
+struct CommandArgument {
+  double number;          // parsed value for CA_INT, CA_UINT and CA_FLOAT
+  const char* payload;    // zero terminated except for CA_RAW
+  unsigned int length;
+  const char* id;         // correlation id of the request
+};
+
+typedef CommandResult(*commandHandler_t)(const CommandArgument& argument);
+
+struct Command {
+  const char* name;
+  CommandArgType argType;
+  double min;             // inclusive range for numeric arguments
+  double max;
+  commandHandler_t handler;
+  CommandExecution execution;
+};
+
+/**
+ * Downlink commands are kept in a table sorted by name, lookup is a binary search with exact
+ * matching. Numeric arguments are parsed from the whole payload and checked against the range
+ * of the command before its handler is called. Use commandsSorted() in a static_assert on the
+ * table so an entry out of order fails the build rather than the lookup.
+ */
+namespace CommandTable {
+
+  constexpr int compare(const char* a, const char* b) {
+    return *a != *b ? (*a < *b ? -1 : 1) : (*a == 0 ? 0 : compare(a + 1, b + 1));
+  }
+
+  template <size_t N>
+  constexpr bool commandsSorted(const Command(&commands)[N], size_t i = 1) {
+    return i >= N ? true : (compare(commands[i - 1].name, commands[i].name) < 0 && commandsSorted(commands, i + 1));
+  }
+
+  const Command* find(const Command* commands, size_t count, const char* name);
+
+  boolean parse(const Command* command, const char* payload, unsigned int length, CommandArgument& argument);
+
+  CommandResult execute(const Command* command, const char* payload, unsigned int length, const char* id);
+
+  // find() and execute(), payload has to be zero terminated
+  CommandResult dispatch(const Command* commands, size_t count, const char* name, const char* payload, unsigned int length, const char* id);
+
+  const char* resultToString(CommandResult result);
+
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _COMMAND_WORKER_H
+#define _COMMAND_WORKER_H
+
+#include <globals.h>
+#include <config.h>
+#include <commandTable.h>
+
+typedef void (*commandResultCallback_t)(const char* command, const char* id, CommandResult result);
+
+/**
+ * Runs downlink commands that may block (sensor calibration, connection tests, delays before a
+ * reboot) on their own task, so the mqtt task keeps servicing the connection. Jobs are taken
+ * from a bounded queue in order, submit() fails instead of waiting when the queue is full.
+ * The result of every job is reported through the result callback, on the worker task, unless
+ * the handler queued it elsewhere (CR_QUEUED) and its final result is reported from there.
+ */
+namespace CommandWorker {
+
+  boolean setup(commandResultCallback_t resultCallback, uint32_t stackSize, UBaseType_t priority, BaseType_t core);
+
+  // takes ownership of payload, which has to be NULL or heap allocated and zero terminated
+  boolean submit(const Command* command, const char* id, char* payload, unsigned int length);
+
+  extern TaskHandle_t commandWorkerTask;
+
+}
+
+#endif
@@ -43,6 +43,8 @@
 
 #define I2C_CLK 100000UL
 #define SCD30_I2C_CLK 50000UL   // SCD30 recommendation of 50kHz
+#define I2C_QUEUE_LENGTH 8
+#define I2C_MAX_DEVICES 8
 
 static const char* CONFIG_FILENAME = "/config.json";
 static const char* MQTT_ROOT_CA_FILENAME = "/mqtt_root_ca.pem";
@@ -50,14 +52,41 @@ static const char* MQTT_CLIENT_CERT_FILENAME = "/mqtt_client_cert.pem";
 static const char* MQTT_CLIENT_KEY_FILENAME = "/mqtt_client_key.pem";
 static const char* TEMP_MQTT_ROOT_CA_FILENAME = "/temp_mqtt_root_ca.pem";
 static const char* ROOT_CA_FILENAME = "/root_ca.pem";
+static const char* TEMP_ROOT_CA_FILENAME = "/temp_root_ca.pem";
+static const char* OFFLINE_STORE_FILENAME = "/offline_samples.bin";
 
 #define MQTT_QUEUE_LENGTH      25
+#define TLS_CONNECT_TIMEOUT_MS 5000
+#define TLS_HANDSHAKE_TIMEOUT_MS 15000
+#define MQTT_RETRY_MS          250    // retry delay of a message that couldn't be sent, and while waiting for WiFi
+#define MQTT_KEEPALIVE_S       15     // PubSubClient's default, the mqtt task wakes up to send the pings
+#define MQTT_DISCONNECT_WAIT_MS 10000 // a connection test waits this long for the mqtt task to close its connection
+#define SENSORS_BATCH_MAX      10
+#define OFFLINE_STORE_PAGES    32     // 4k pages of 102 samples each
+#define OFFLINE_REPLAY_INTERVAL_MS 500
+#define SENSORS_PHASE_MS       1000
+#define SPS30_WARMUP_MS        5000
+#define SPS30_CLEAN_MS         10000  // fan cleaning runs for 10s
+#define SCD40_STOP_MS          500    // stop_periodic_measurement execution time
+#define SCD40_COMMAND_QUEUE_LENGTH 8
+#define METRICS_INTERVAL_MS    (5 * 60 * 1000)
+#define MQTT_TELEMETRY_JSON_SIZE 512
+#define MQTT_TRENDS_JSON_SIZE  2048   // payload with all 8 metrics and 3 windows each
+#define COMMAND_QUEUE_LENGTH    4
+#define COMMAND_NAME_LEN       32
+#define COMMAND_ID_LEN         16
+
+#define EVENT_QUEUE_LENGTH      8
+#define EVENT_BUS_MAX_SUBSCRIBERS 6
+
+#define HISTORY_LENGTH        720   // 1h of SCD4x samples at 5s
+#define HISTORY_PM_LENGTH      64   // 1h of SPS30 samples at 60s
 
 #define PWM_CHANNEL_FAN         0
 #define PWM_CHANNEL_BUZZER      2
 
 // ----------------------------  Config struct ------------------------------------- 
-#define CONFIG_SIZE 1280
+#define CONFIG_SIZE 1536
 
 #define MQTT_USERNAME_LEN 20
 #define MQTT_PASSWORD_LEN 20
@@ -84,6 +113,16 @@ struct Config {
   uint16_t mqttMirrordeviceId;
   char mqttMirrorTopic[MQTT_TOPIC_LEN + 1];
   uint16_t mqttServerPort;
+  bool mqttMsgPack;
+  uint16_t mqttReconnectMin;      // s, backoff ceiling after the first failure, doubles up to the max
+  uint16_t mqttReconnectMax;      // s
+  uint16_t deadbandCo2;
+  uint8_t deadbandTemperature;    // 1/10 °C
+  uint8_t deadbandHumidity;       // 1/10 %
+  uint16_t deadbandPm;
+  uint16_t sensorsHeartbeat;      // s
+  uint8_t sensorsBatchSize;
+  uint16_t sensorsBatchInterval;  // s
   uint16_t altitude;
   uint16_t co2GreenThreshold;
   uint16_t co2YellowThreshold;
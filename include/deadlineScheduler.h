@@ -0,0 +1,64 @@
+#ifndef _DEADLINE_SCHEDULER_H
+#define _DEADLINE_SCHEDULER_H
+
+#include <globals.h>
+
+#define DEADLINE_SCHEDULER_JOBS 8
+
+// runs the job and returns the period until its next run in ms, 0 removes the job
+typedef uint32_t(*deadlineJob_t)(void* arg);
+typedef uint32_t(*randomSource_t)(void);
+
+/**
+ * Periodic jobs kept in a min-heap ordered by their next deadline. Deadlines advance by whole
+ * periods from the first one, so runs don't drift however late a wakeup is, and a wakeup that is
+ * more than a period late skips the runs it missed (counted) instead of catching up in a burst.
+ * Each run may be delayed by a random jitter of up to jitterMs, the jitter doesn't accumulate.
+ * All comparisons are done on the signed difference of millis() values, so wraparound is fine
+ * as long as periods stay below 2^31 ms. Not thread safe, meant to be owned by one task.
+ */
+class DeadlineScheduler {
+public:
+  DeadlineScheduler(randomSource_t random = esp_random);
+
+  // phaseMs delays the first run, returns the job id or -1 if the scheduler is full
+  int8_t add(const char* name, deadlineJob_t job, void* arg, uint32_t periodMs, uint32_t phaseMs, uint32_t jitterMs, uint32_t now);
+  // the job ran outside the scheduler, its next run is one period after now
+  void ranAt(int8_t id, uint32_t now);
+
+  // runs all jobs due at now and returns the time until the next deadline, UINT32_MAX if there's no job
+  uint32_t runDue(uint32_t now);
+  uint32_t msUntilNext(uint32_t now);
+
+  uint32_t getRuns(int8_t id);
+  uint32_t getMissed(int8_t id);
+  // deadline of the next run without jitter
+  uint32_t getNextDeadline(int8_t id);
+
+private:
+  struct Job {
+    const char* name;
+    deadlineJob_t run;
+    void* arg;
+    uint32_t periodMs;
+    uint32_t jitterMs;
+    uint32_t base;      // unjittered deadline
+    uint32_t due;       // base plus this run's jitter
+    uint32_t runs;
+    uint32_t missed;
+    boolean active;
+  };
+
+  randomSource_t random;
+  Job jobs[DEADLINE_SCHEDULER_JOBS];
+  int8_t heap[DEADLINE_SCHEDULER_JOBS];
+  uint8_t heapSize;
+
+  void schedule(Job& job, uint32_t base);
+  void siftUp(uint8_t index);
+  void siftDown(uint8_t index);
+  void fix(int8_t id);
+  boolean before(int8_t a, int8_t b);
+};
+
+#endif
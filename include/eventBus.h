@@ -0,0 +1,49 @@
+#ifndef _EVENT_BUS_H
+#define _EVENT_BUS_H
+
+#include <globals.h>
+#include <model.h>
+
+typedef void (*modelEventHandler_t)(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data);
+
+struct EventBusStats {
+  uint32_t handled;
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+  uint64_t totalLatencyUs;
+};
+
+/**
+ * Decouples Model updates from their consumers. publish() only copies the event into one bounded
+ * queue and never blocks, a single dispatcher task drains it and calls the interested subscribers
+ * in the order they subscribed, so a handler can rely on the ones before it having seen the same
+ * event. Handlers must not block for long, the next subscriber waits for them. Events that don't
+ * fit into a full queue are dropped and counted. Every event carries the readings it was published
+ * for, handlers see those rather than whatever came after. Latency is measured per subscriber from
+ * publish() to the start of its handler.
+ */
+namespace EventBus {
+
+  // creates the queue and the dispatcher task
+  boolean setup(uint32_t stackSize, UBaseType_t priority, BaseType_t core);
+
+  boolean subscribe(const char* name, uint16_t mask, modelEventHandler_t handler);
+
+  void publish(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data);
+
+  uint8_t getSubscriberCount();
+
+  const char* getSubscriberName(uint8_t index);
+
+  EventBusStats getStats(uint8_t index);
+
+  // events lost to a full queue
+  uint32_t getDropped();
+
+  void logStats();
+
+  extern TaskHandle_t dispatcherTask;
+
+}
+
+#endif
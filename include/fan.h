@@ -13,7 +13,7 @@ public:
   Fan(Model* model);
   ~Fan();
 
-  void update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus);
+  void update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data);
 
   uint8_t getRpm();
   void setFanPwm(uint8_t pwm);
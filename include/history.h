@@ -0,0 +1,65 @@
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+#include <Arduino.h>
+
+typedef enum {
+  HW_1MIN = 0,
+  HW_15MIN,
+  HW_1H,
+  HW_COUNT
+} HistoryWindow;
+
+// window lengths in ms, the longest window has to come last
+const uint32_t HISTORY_WINDOW_MS[HW_COUNT] = { 60 * 1000UL, 15 * 60 * 1000UL, 60 * 60 * 1000UL };
+
+struct HistoryStats {
+  float min;
+  float max;
+  float mean;
+  uint16_t count;
+};
+
+/**
+ * Fixed capacity ring buffer holding up to N samples of M metrics, one array per metric.
+ *
+ * Statistics for each HistoryWindow are maintained incrementally on append: a running sum per
+ * window, and per metric one monotonic min and one max deque covering the longest window. The
+ * extremes of the shorter windows are read from the same deques through cursors that only ever
+ * move forward, so append and getStats are amortised O(1) and nothing is allocated after
+ * construction. Not thread safe, callers need to serialise access.
+ */
+template <typename T, uint16_t N, uint8_t M>
+class History {
+public:
+  History();
+
+  void append(uint32_t timestamp, const T sample[M]);
+  HistoryStats getStats(uint8_t metric, HistoryWindow window, uint32_t now);
+  uint16_t size();
+  void clear();
+
+private:
+  struct Deque {
+    uint16_t slot[N];
+    uint32_t front;   // positions are running counters, slot index is position % N
+    uint32_t back;
+  };
+
+  uint32_t timestamps[N];
+  T values[M][N];
+  uint32_t count;
+  uint32_t windowStart[HW_COUNT];
+  int32_t sums[HW_COUNT][M];
+  Deque minDeque[M];
+  Deque maxDeque[M];
+  uint32_t minCursor[HW_COUNT][M];
+  uint32_t maxCursor[HW_COUNT][M];
+
+  uint32_t sequenceOf(uint16_t slot);
+  void push(Deque& deque, uint32_t cursors[HW_COUNT][M], uint8_t metric, uint16_t slot, bool isMin);
+  void evictOldest(uint8_t window);
+  void expire(uint32_t now);
+};
+
+#endif
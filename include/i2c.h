@@ -2,8 +2,11 @@
 #define _I2C_H
 
 #include <globals.h>
+#include <i2cBackend.h>
 
-#define I2C_MUTEX_DEF_WAIT pdMS_TO_TICKS(5000)
+#define I2C_QUEUE_WAIT pdMS_TO_TICKS(5000)
+// task notification bit the bus task sets on the caller when its transaction is done, reserved in every task
+#define X_CMD_I2C_DONE bit(31)
 
 namespace I2C {
 #define SSD1306_I2C_ADR 0x3C
@@ -12,14 +15,58 @@ namespace I2C {
 #define SPS30_I2C_ADR 0x69
 #define BME680_I2C_ADR 0x76
 
-  void initI2C();
+  // runs on the bus task with the bus set to the transaction's clock, for drivers built on libraries
+  // that talk to Wire themselves
+  typedef boolean (*i2cTransactionCallback_t)(void* arg);
+
+  /**
+   * One unit of bus work: either a write of writeLength bytes followed, after readDelayMs, by a read of
+   * readLength bytes (a probe when both are 0), handed to the backend, or a callback. The caller blocks until the bus task has run it, so the
+   * descriptor and buffers can live on the caller's stack.
+   */
+  struct Transaction {
+    uint8_t address;
+    uint32_t clock;
+    const uint8_t* writeBuffer;
+    size_t writeLength;
+    uint8_t* readBuffer;
+    size_t readLength;
+    uint16_t readDelayMs;
+    i2cTransactionCallback_t run;
+    void* arg;
+    boolean success;
+    TaskHandle_t caller;
+  };
+
+  struct DeviceStats {
+    uint8_t address;
+    uint32_t transactions;
+    uint32_t failures;
+    uint64_t busUs;   // time the device held the bus, including clock switches for it
+    uint32_t maxUs;
+  };
+
+  // raw transactions go through the backend, callbacks use Wire directly
+  void initI2C(I2CBackend* backend, uint32_t stackSize, UBaseType_t priority, BaseType_t core);
   void shutDownI2C();
 
-  boolean takeMutex(TickType_t blockTime);
-  void giveMutex();
+  // false if the transaction could not be queued within blockTime or failed
+  boolean transact(Transaction& transaction, TickType_t blockTime = I2C_QUEUE_WAIT);
+  boolean transact(uint8_t address, uint32_t clock, i2cTransactionCallback_t run, void* arg);
+  template <typename T>
+  boolean transact(uint8_t address, uint32_t clock, boolean(*run)(T*), T* arg) {
+    return transact(address, clock, (i2cTransactionCallback_t)run, (void*)arg);
+  }
+
+  // fills stats for up to max devices, returns how many there are
+  uint8_t getDeviceStats(DeviceStats* stats, uint8_t max);
+  uint32_t getClockChanges();
+  void logStats();
 
   boolean scd30Present();
   boolean scd40Present();
   boolean sps30Present();
+
+  extern TaskHandle_t i2cTask;
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,27 @@
+#ifndef _I2C_BACKEND_H
+#define _I2C_BACKEND_H
+
+#include <globals.h>
+#include <Wire.h>
+
+/**
+ * Moves the bytes of a raw I2C transaction for the bus task: writeLength bytes, then after
+ * readDelayMs readLength bytes. A transaction without either only probes the address.
+ */
+class I2CBackend {
+public:
+  virtual ~I2CBackend() {}
+  virtual boolean transfer(uint8_t address, const uint8_t* writeBuffer, size_t writeLength, uint8_t* readBuffer, size_t readLength, uint16_t readDelayMs) = 0;
+};
+
+// Arduino TwoWire, limited to its buffer size per transfer. A write straight followed by a read uses a repeated start.
+class WireBackend :public I2CBackend {
+public:
+  WireBackend(TwoWire* wire);
+  boolean transfer(uint8_t address, const uint8_t* writeBuffer, size_t writeLength, uint8_t* readBuffer, size_t readLength, uint16_t readDelayMs) override;
+
+private:
+  TwoWire* wire;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <Arduino.h>
+#include <config.h>
+#include <esp_timer.h>
+
+typedef enum {
+  LS_SENSOR_READ = 0,   // I2C read of a measurement
+  LS_MODEL_UPDATE,      // Model::updateModel incl. history and event publish
+  LS_DISPATCH,          // model updated until the mqttPublish subscriber runs
+  LS_MQTT_QUEUE,        // mqttQueue enqueue until the mqtt task picks it up
+  LS_PUBLISH,           // mqtt_client->publish
+  LS_END_TO_END,        // model updated until published
+  LS_COUNT
+} LatencyStage;
+
+const char* const LATENCY_STAGE_NAMES[LS_COUNT] = { "read", "model", "dispatch", "queue", "publish", "total" };
+
+// upper bounds of the histogram buckets in us, one more bucket collects everything above
+#define LATENCY_BUCKETS 14
+const uint32_t LATENCY_BUCKET_BOUNDS[LATENCY_BUCKETS - 1] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000 };
+
+struct LatencyHistogram {
+  uint32_t buckets[LATENCY_BUCKETS];
+  uint32_t count;
+  uint32_t maxUs;
+  uint64_t totalUs;
+};
+
+#define LATENCY_JSON_SIZE 1024
+
+/**
+ * Per stage latency histograms along the path of a reading from the sensor to the MQTT broker.
+ * Timestamps are the lower 32 bits of esp_timer_get_time(), differences are wraparound safe as
+ * long as a reading spends less than ~71 minutes in the pipeline. record() is cheap enough for
+ * the hot path: a bucket lookup and a few additions in a short critical section.
+ */
+namespace Latency {
+
+  inline uint32_t now() {
+    return (uint32_t)esp_timer_get_time();
+  }
+
+  void record(LatencyStage stage, uint32_t us);
+
+  // records the time passed since start, a value returned by now()
+  inline void recordSince(LatencyStage stage, uint32_t start) {
+    record(stage, now() - start);
+  }
+
+  LatencyHistogram getHistogram(LatencyStage stage);
+
+  void reset();
+
+  // Serialises all histograms as JSON and resets them, returns the length or 0 on failure
+  size_t serializeAndReset(char* buf, size_t size, uint32_t intervalMs);
+
+}
+
+#endif
@@ -2,6 +2,9 @@
 #define _MODEL_H
 
 #include <Arduino.h>
+#include <config.h>
+#include <history.h>
+#include <atomic>
 
 const float NaN = sqrt(-1);
 
@@ -28,7 +31,35 @@ typedef enum {
   DARK_RED
 } TrafficLightStatus;
 
-typedef void (*modelUpdatedEvt_t)(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus);
+typedef enum {
+  H_CO2 = 0,
+  H_TEMPERATURE,
+  H_HUMIDITY,
+  H_PM0_5,
+  H_PM1,
+  H_PM2_5,
+  H_PM4,
+  H_PM10
+} HistoryMetric;
+
+// Consistent copy of all readings, see Model::snapshot()
+struct ModelSnapshot {
+  TrafficLightStatus status;
+  float temperature;
+  float humidity;
+  uint16_t co2;
+  uint16_t pressure;
+  uint16_t iaq;
+  uint16_t pm0_5;
+  uint16_t pm1;
+  uint16_t pm2_5;
+  uint16_t pm4;
+  uint16_t pm10;
+  uint32_t updated;     // Latency::now() of the last update
+};
+
+// data is the model as this update left it, consumers running later must not read the model instead
+typedef void (*modelUpdatedEvt_t)(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data);
 
 class Model {
 public:
@@ -49,6 +80,10 @@ public:
 
   TrafficLightStatus getStatus();
 
+  ModelSnapshot snapshot();
+
+  HistoryStats getHistory(HistoryMetric metric, HistoryWindow window);
+
   void updateModel(uint16_t _co2);
   void updateModel(uint16_t co2, float temperature, float humidity);
   void updateModel(float temperature, float humidity, uint16_t pressure, uint16_t iaq);
@@ -57,19 +92,25 @@ public:
 
 private:
 
-  TrafficLightStatus status;
-  float temperature;
-  float humidity;
-  uint16_t co2;
-  uint16_t pressure;
-  uint16_t iaq;
-  uint16_t pm0_5;
-  uint16_t pm1;
-  uint16_t pm2_5;
-  uint16_t pm4;
-  uint16_t pm10;
+  // readings are published through a seqlock: writers are serialised by writeMux and bump the
+  // sequence to odd before and back to even after changing data, readers retry until they copied
+  // data under an unchanged even sequence
+  ModelSnapshot data;
+  std::atomic<uint32_t> sequence;
+  portMUX_TYPE writeMux = portMUX_INITIALIZER_UNLOCKED;
   modelUpdatedEvt_t modelUpdatedEvt;
   void updateStatus();
+  uint32_t beginWrite();
+  void endWrite();
+
+  // temperature and humidity are kept in 1/10 units
+  History<uint16_t, HISTORY_LENGTH, 1>* co2History;
+  History<int16_t, HISTORY_LENGTH, 2>* climateHistory;
+  History<uint16_t, HISTORY_PM_LENGTH, 5>* pmHistory;
+  portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+  // takes the values as written inside the write section, data may have moved on since
+  void appendHistory(uint16_t mask, const ModelSnapshot& written);
 
 };
 
@@ -5,6 +5,9 @@
 #include <model.h>
 #include <ArduinoJson.h>
 #include <messageSupport.h>
+#include <sensorSample.h>
+#include <commandTable.h>
+#include <esp_event.h>
 
 // If you issue really large certs (e.g. long CN, extra options) this value may need to be
 // increased, but 1600 is plenty for a typical CN and standard option openSSL issued cert.
@@ -15,8 +18,29 @@
 
 
 namespace mqtt {
-  typedef void (*calibrateCo2SensorCallback_t)(uint16_t);
-  typedef void (*setTemperatureOffsetCallback_t)(float);
+  struct MqttQueueStats {
+    uint32_t controlDropped;    // status, config and command result messages dropped on a full queue
+    uint32_t samplesCoalesced;  // samples merged into one still waiting to be sent
+    uint32_t metricsCoalesced;  // metric values overwritten before they were sent
+    uint8_t controlHighWater;   // most control messages waiting at once
+  };
+
+  // cumulative since boot
+  struct MqttConnectionStats {
+    uint32_t connects;
+    uint32_t disconnects;       // connections lost, not counting a shutdown
+    uint32_t lastReconnectMs;   // from losing the connection to the next successful connect
+    uint32_t maxReconnectMs;
+    uint64_t connectedMs;       // including the current connection
+    uint32_t publishes;
+    uint32_t publishFailures;
+    uint32_t bytesSent;         // topic and payload of all publishes
+    uint32_t bytesReceived;     // topic and payload of all received messages
+  };
+
+  // id is the correlation id of the request, CR_QUEUED if the result is published later on
+  typedef CommandResult(*calibrateCo2SensorCallback_t)(uint16_t co2Reference, const char* id);
+  typedef CommandResult(*setTemperatureOffsetCallback_t)(float temperatureOffset, const char* id);
   typedef float (*getTemperatureOffsetCallback_t)(void);
   typedef uint32_t(*getSPS30AutoCleanIntervalCallback_t)(void);
   typedef boolean(*setSPS30AutoCleanIntervalCallback_t)(uint32_t);
@@ -37,11 +61,23 @@ namespace mqtt {
   );
   void shutDownMqtt();
 
-  void publishSensors(DynamicJsonDocument* _payload);
+  void publishSensors(const SensorSample& sample);
   void publishConfiguration();
   void publishStatusMsg(const char* statusMessage);
+  // final result of a command that was queued past the command worker
+  void publishCommandResult(const char* command, const char* id, CommandResult result);
+  // same for calibrate, with the correction in ppm
+  void publishCalibrationResult(const char* id, boolean success, int16_t frcCorrection);
+  // topics are rebuilt from the configuration by the mqtt task
+  void configurationChanged();
 
   void mqttLoop(void* pvParameters);
+  // number of times the mqtt task woke up since boot
+  uint32_t getLoopWakeups();
+  MqttQueueStats getQueueStats();
+  MqttConnectionStats getConnectionStats();
+  // IP_EVENT_STA_GOT_IP triggers an immediate reconnect attempt
+  void eventHandler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 
   extern TaskHandle_t mqttTask;
 }
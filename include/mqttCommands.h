@@ -0,0 +1,29 @@
+#ifndef _MQTT_COMMANDS_H
+#define _MQTT_COMMANDS_H
+
+#include <commandTable.h>
+
+// Downlink commands, received under <topic>/[<id>/]down/<command>. The handlers are implemented in mqtt.cpp
+namespace mqtt {
+
+  CommandResult calibrateCommand(const CommandArgument& argument);
+  CommandResult cleanSPS30Command(const CommandArgument& argument);
+  CommandResult forceOtaCommand(const CommandArgument& argument);
+  CommandResult getConfigCommand(const CommandArgument& argument);
+  CommandResult getTelemetryCommand(const CommandArgument& argument);
+  CommandResult getTrendsCommand(const CommandArgument& argument);
+  CommandResult installMqttRootCaCommand(const CommandArgument& argument);
+  CommandResult installRootCaCommand(const CommandArgument& argument);
+  CommandResult otaCommand(const CommandArgument& argument);
+  CommandResult rebootCommand(const CommandArgument& argument);
+  CommandResult resetWifiCommand(const CommandArgument& argument);
+  CommandResult setConfigCommand(const CommandArgument& argument);
+  CommandResult setSPS30AutoCleanIntervalCommand(const CommandArgument& argument);
+  CommandResult setTemperatureOffsetCommand(const CommandArgument& argument);
+
+  extern const Command* const COMMANDS;
+  extern const size_t COMMAND_COUNT;
+
+}
+
+#endif
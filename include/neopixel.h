@@ -13,7 +13,7 @@ public:
   Neopixel(Model* model, uint8_t pin, uint8_t numPixel);
   ~Neopixel();
 
-  void update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus);
+  void update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data);
   void prepareToSleep();
   void off();
 
@@ -11,7 +11,7 @@ namespace OTA {
   void checkForUpdate();
   extern TaskHandle_t otaTask;
   void otaLoop(void* pvParameters);
-  void forceUpdate(char* url);
+  void forceUpdate(const char* url);
 }
 
 #endif
\ No newline at end of file
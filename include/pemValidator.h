@@ -0,0 +1,38 @@
+#ifndef _PEM_VALIDATOR_H
+#define _PEM_VALIDATOR_H
+
+#include <Arduino.h>
+
+// longest line accepted, base64 bodies are wrapped at 64 (RFC 7468) or 76 characters
+#define PEM_MAX_LINE 80
+
+/**
+ * Checks a PEM encoded certificate (chain) while it is being received in arbitrary chunks, so it
+ * can be streamed to a file without holding it in memory. Accepts one or more
+ * BEGIN/END CERTIFICATE blocks with base64 bodies, CRLF or LF line endings and blank lines
+ * between blocks. Once an error is found the remaining input is ignored.
+ */
+class PemValidator {
+public:
+  PemValidator();
+
+  void reset();
+  void update(const uint8_t* data, size_t length);
+  // processes a last line without line ending, true if the input was a complete certificate (chain)
+  boolean finish();
+
+  boolean hasError();
+  uint8_t getCertificates();
+
+private:
+  char line[PEM_MAX_LINE + 1];
+  uint8_t lineLength;
+  boolean inBlock;
+  boolean error;
+  uint8_t certificates;
+  uint32_t bodyLength;
+
+  void processLine();
+};
+
+#endif
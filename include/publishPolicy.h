@@ -0,0 +1,36 @@
+#ifndef _PUBLISH_POLICY_H
+#define _PUBLISH_POLICY_H
+
+#include <globals.h>
+#include <config.h>
+#include <sensorSample.h>
+
+// number of Measurement bits that carry a value (M_CO2 .. M_PM10)
+#define PUBLISH_POLICY_METRICS 10
+
+/**
+ * Decides which values of a sample are worth publishing: a value is only sent when it moved by at
+ * least its configured deadband since it was last sent, or when it hasn't been sent for
+ * config.sensorsHeartbeat seconds. Deadbands of 0 publish every sample.
+ */
+class PublishPolicy {
+public:
+  PublishPolicy();
+
+  // clears the mask bits of all values that don't need publishing and returns the remaining mask
+  uint16_t apply(SensorSample& sample, uint32_t now);
+  void reset();
+
+  uint32_t getSuppressed();
+
+private:
+  int32_t lastValue[PUBLISH_POLICY_METRICS];
+  uint32_t lastPublished[PUBLISH_POLICY_METRICS];
+  uint16_t published;
+  uint32_t suppressed;
+
+  int32_t getValue(const ModelSnapshot& data, uint8_t metric);
+  uint16_t getDeadband(uint8_t metric);
+};
+
+#endif
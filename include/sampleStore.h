@@ -0,0 +1,76 @@
+#ifndef _SAMPLE_STORE_H
+#define _SAMPLE_STORE_H
+
+#include <globals.h>
+#include <config.h>
+#include <FS.h>
+#include <sensorSample.h>
+
+#define SAMPLE_STORE_PAGE_SIZE 4096
+#define SAMPLE_STORE_MAGIC 0x53425243   // "CRBS"
+
+// at the start of every page in the file
+struct SampleStorePageHeader {
+  uint32_t magic;       // SAMPLE_STORE_MAGIC, cleared once the page has been replayed
+  uint32_t sequence;    // position of the page in the FIFO
+  uint32_t boot;        // boot the samples were taken in
+  uint32_t count;       // always a full page, anything else was written by a different layout
+};
+
+#define SAMPLE_STORE_PAGE_SAMPLES ((SAMPLE_STORE_PAGE_SIZE - sizeof(SampleStorePageHeader)) / sizeof(SensorSample))
+
+struct SampleStorePage {
+  SampleStorePageHeader header;
+  SensorSample samples[SAMPLE_STORE_PAGE_SAMPLES];
+};
+
+/**
+ * FIFO of sensor samples backed by a file of maxPages page slots used as a ring. Samples are
+ * collected in a RAM page and only written once a page is full, always as one whole page, to keep
+ * flash wear down. When all slots hold unreplayed pages the oldest page is overwritten, the newest
+ * readings are the ones worth keeping after a long outage. Reads start at the oldest sample and
+ * don't remove anything until consume() is called, so samples survive a failed publish. A fully
+ * replayed page is marked in its header and the file is removed once it has been read completely.
+ * Pages survive a reboot, begin() picks them up again. Sample timestamps are millis() of the boot
+ * they were taken in, every page records that boot so older ones can be told apart. The RAM page
+ * is lost on reboot, and a page that was only partly replayed is replayed again in full.
+ * Not thread safe.
+ */
+class SampleStore {
+public:
+  SampleStore(FS* fs, const char* filename, uint16_t maxPages);
+  ~SampleStore();
+
+  void begin();
+  boolean append(const SensorSample& sample);
+  // the samples of one call are all from the same boot, previousBoot tells whether it was an earlier one
+  uint8_t read(SensorSample* samples, uint8_t count, boolean* previousBoot = NULL);
+  void consume(uint8_t count);
+  uint32_t size();
+
+  uint32_t getBoot();
+  uint32_t getDropped();
+  uint32_t getPagesWritten();
+
+private:
+  FS* fs;
+  const char* filename;
+  uint16_t maxPages;
+  uint32_t boot;
+
+  SampleStorePage page;
+  uint16_t pageCount;       // samples in page
+  uint16_t pageRead;        // samples of page already consumed, only while the file is empty
+  uint32_t firstPage;       // sequence of the oldest page in the file
+  uint32_t nextPage;        // sequence of the page written next
+  uint32_t fileRead;        // samples of the oldest page already consumed
+  uint32_t dropped;
+  uint32_t pagesWritten;
+
+  uint32_t filePages();
+  uint32_t pageOffset(uint32_t sequence);
+  boolean writePage();
+  void pageReplayed();
+};
+
+#endif
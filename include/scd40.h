@@ -14,17 +14,50 @@ typedef enum {
   LP_PERIODIC
 } SCD40SampleRate;
 
+typedef enum {
+  SCD40_SET_TEMPERATURE_OFFSET = 0,
+  SCD40_SET_ALTITUDE,
+  SCD40_SET_ASC,
+  SCD40_FORCED_RECALIBRATION
+} SCD40CommandType;
+
+struct SCD40Command {
+  SCD40CommandType type;
+  float value;
+  char id[COMMAND_ID_LEN + 1];  // correlation id of the request, reported with the result
+};
+
+// outcome of a queued temperature offset or forced recalibration, with the id it was queued with,
+// frcCorrection in ppm, only valid for a successful recalibration
+typedef void (*scd40CommandResultCallback_t)(SCD40CommandType type, const char* id, boolean success, int16_t frcCorrection);
+
+// settings the sensor persists, read once at start and kept in step with every write
+struct SCD40Settings {
+  float temperatureOffset;
+  uint16_t altitude;
+  boolean ascEnabled;
+};
+
 class SCD40 {
 public:
-  SCD40(TwoWire* pwire, Model* _model, updateMessageCallback_t _updateMessageCallback);
+  SCD40(TwoWire* pwire, Model* _model, updateMessageCallback_t _updateMessageCallback, scd40CommandResultCallback_t _commandResultCallback);
   ~SCD40();
 
   boolean readScd40();
+  // reads a measurement or, with commands queued, stops the measurement and applies all of them in
+  // one go before restarting it; returns the ms until it wants to run again
+  uint32_t step();
   uint32_t getInterval();
 
-  boolean calibrateScd40ToReference(uint16_t co2Reference);
-  boolean setTemperatureOffset(float temperatureOffset);
+  // queued, applied with the next step(), false if the queue is full
+  // the outcome of calibration and temperature offset is reported through the command result callback
+  boolean calibrateScd40ToReference(uint16_t co2Reference, const char* id);
+  boolean setTemperatureOffset(float temperatureOffset, const char* id);
+  boolean setSensorAltitude(uint16_t altitude);
+  boolean setAutomaticSelfCalibration(boolean enabled);
+  // from the cache, no I2C traffic
   float getTemperatureOffset();
+  SCD40Settings getSettings();
   boolean setAmbientPressure(uint16_t ambientPressureInHpa);
 
   boolean setSampleRate(SCD40SampleRate sampleRate);
@@ -34,11 +67,20 @@ private:
   Model* model;
   SensirionI2CScd4x* scd40;
   updateMessageCallback_t updateMessageCallback;
+  scd40CommandResultCallback_t commandResultCallback;
   uint16_t lastAmbientPressure = 0x0000;
+  QueueHandle_t commandQueue;
+  SCD40Settings settings;
+  boolean stopped = false;
 
   boolean startMeasurement();
+  boolean queueCommand(SCD40CommandType type, float value, const char* id = "");
+  boolean applyCommand(const SCD40Command& command);
+  void applyCommands();
 
   boolean checkError(uint16_t error, char const* msg);
+  // command with a response of count words, checked against their CRC, as a raw transaction
+  boolean readWords(uint16_t command, uint16_t* words, uint8_t count);
   static void scd40Loop(void* pvParameters);
 
   SCD40SampleRate sampleRate;
@@ -0,0 +1,39 @@
+#ifndef _SENSOR_SAMPLE_H
+#define _SENSOR_SAMPLE_H
+
+#include <Arduino.h>
+#include <config.h>
+#include <model.h>
+
+// Fixed size record of one model update, passed by value through the mqtt queue.
+// Only the values flagged in mask are serialised.
+struct SensorSample {
+  uint16_t mask;
+  uint8_t fanPwm;
+  uint32_t timestamp;   // millis() when the sample was taken
+  ModelSnapshot data;
+};
+
+typedef enum {
+  SSE_JSON = 0,
+  SSE_MSGPACK
+} SensorSampleEncoding;
+
+// Largest serialised sample is ~190 bytes, ~205 in a batch replayed from a previous boot
+#define SENSOR_SAMPLE_JSON_SIZE 256
+#define SENSOR_BATCH_JSON_SIZE (SENSORS_BATCH_MAX * (SENSOR_SAMPLE_JSON_SIZE - 40) + 2)
+
+// Serialises the sample as object into buf, returns the length or 0 on failure.
+// JSON carries temperature and humidity as strings with one decimal, MessagePack as numbers.
+size_t serializeSensorSample(const SensorSample& sample, char* buf, size_t size, SensorSampleEncoding encoding = SSE_JSON);
+
+// Serialises the samples as array into buf, each object carries the age of the sample in ms
+// relative to now. Samples taken before a reboot have no age, they carry their uptime in ms and
+// previousBoot instead. Returns the length or 0 on failure
+size_t serializeSensorSamples(const SensorSample* samples, uint8_t count, uint32_t now, char* buf, size_t size, SensorSampleEncoding encoding = SSE_JSON, boolean previousBoot = false);
+
+// Merges newer into pending, keeping the newest value of every metric flagged in either mask.
+// Returns the number of metrics of pending that were overwritten.
+uint8_t coalesceSensorSample(SensorSample& pending, const SensorSample& newer);
+
+#endif
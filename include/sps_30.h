@@ -9,16 +9,27 @@
 #include <model.h>
 #include <sps30.h>
 
+typedef enum {
+  SPS30_IDLE = 0,
+  SPS30_CLEANING,
+  SPS30_WARMING_UP
+} SPS30State;
+
 class SPS_30 {
 public:
-  SPS_30(TwoWire* pwire, Model* _model, updateMessageCallback_t _updateMessageCallback);
+  SPS_30(TwoWire* pwire, Model* _model, updateMessageCallback_t _updateMessageCallback, publishMessageCallback_t _publishMessageCallback);
   ~SPS_30();
 
+  // advances the measurement cycle (start, optional fan clean, warm up, read and stop) by one step
+  // without waiting, returns the ms until the next step is due
+  uint32_t step();
+  // whole cycle in one go, blocks for the warm up
   boolean readSps30();
   uint32_t getInterval();
 
   uint32_t getAutoCleanInterval();
   boolean setAutoCleanInterval(uint32_t intervalInSeconds);
+  // the fan clean is done as part of the next measurement cycle, its outcome is published as message
   boolean clean();
   uint8_t getStatus();
 
@@ -26,9 +37,16 @@ private:
   Model* model;
   SPS30* sps30;
   updateMessageCallback_t updateMessageCallback;
+  publishMessageCallback_t publishMessageCallback;
+  boolean initialised = false;
+  SPS30State state = SPS30_IDLE;
+  uint32_t cycleMs = 0;
+  boolean lastReadOk = false;
+  volatile boolean cleanRequested = false;
 
+  uint32_t startMeasurement();
+  uint32_t readAndStop();
   boolean checkError(uint16_t error, char const* msg);
-  static void sps30Loop(void* pvParameters);
 };
 
 #endif
\ No newline at end of file
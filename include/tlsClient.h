@@ -0,0 +1,105 @@
+#ifndef _TLS_CLIENT_H
+#define _TLS_CLIENT_H
+
+#include <globals.h>
+#include <config.h>
+#include <Client.h>
+#include <IPAddress.h>
+
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/pk.h>
+
+/**
+ * Root CA, client cert and client key parsed once from their PEM files on LittleFS. The parsed
+ * (DER based) mbedTLS structures stay in memory, so a reconnect doesn't read and parse the files
+ * again. A handshake uses the key context, so TlsClients on different tasks need their own copy.
+ */
+class TlsCredentials {
+public:
+  TlsCredentials();
+  ~TlsCredentials();
+
+  // missing files are skipped, false if a file exists but can't be parsed
+  boolean load(const char* rootCaFilename, const char* clientKeyFilename, const char* clientCertFilename);
+
+  boolean hasRootCa();
+  boolean hasClientCert();
+
+private:
+  mbedtls_x509_crt rootCa;
+  mbedtls_x509_crt clientCert;
+  mbedtls_pk_context clientKey;
+  boolean rootCaLoaded;
+  boolean clientCertLoaded;
+
+  // the buffer is zero terminated and has to be freed by the caller
+  unsigned char* readFile(const char* filename, size_t* length);
+
+  friend class TlsClient;
+};
+
+/**
+ * Minimal TLS client on top of an lwIP socket and mbedTLS for PubSubClient. The SSL configuration
+ * is set up once per client, and the session of the last connection is kept so the next connect
+ * can resume it (session ticket or session id) instead of doing a full handshake.
+ */
+class TlsClient : public Client {
+public:
+  TlsClient(TlsCredentials* credentials, boolean insecure);
+  ~TlsClient();
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t* buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t* buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool();
+
+  // drops the kept session, the next connect does a full handshake
+  void forgetSession();
+
+  // the lwIP socket, -1 while not connected
+  int fd();
+
+  uint32_t getHandshakeMs();
+  boolean isResumed();
+
+private:
+  TlsCredentials* credentials;
+  boolean insecure;
+  int socket;
+  boolean configured;
+  boolean sslConnected;
+  int peeked;
+
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context ctrDrbg;
+  mbedtls_ssl_config conf;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_session session;
+  boolean sessionSaved;
+  unsigned char sessionMaster[48];
+
+  uint32_t handshakeMs;
+  boolean resumed;
+
+  boolean setupConfig();
+  int connect(const char* host, IPAddress ip, uint16_t port);
+  boolean openSocket(IPAddress ip, uint16_t port);
+  void saveSession();
+  void logError(const char* what, int ret);
+
+  static int bioSend(void* ctx, const unsigned char* buf, size_t length);
+  static int bioRecv(void* ctx, unsigned char* buf, size_t length);
+};
+
+#endif
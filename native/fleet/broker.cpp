@@ -0,0 +1,404 @@
+#include <broker.h>
+#include <globals.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+#define PKT_CONNECT     1
+#define PKT_CONNACK     2
+#define PKT_PUBLISH     3
+#define PKT_PUBACK      4
+#define PKT_SUBSCRIBE   8
+#define PKT_SUBACK      9
+#define PKT_UNSUBSCRIBE 10
+#define PKT_UNSUBACK    11
+#define PKT_PINGREQ     12
+#define PKT_PINGRESP    13
+#define PKT_DISCONNECT  14
+
+Broker::Broker(const char* topic) {
+  this->topic = topic;
+  this->port = 0;
+  this->listenSocket = -1;
+  this->started = 0;
+  this->downUntil = 0;
+  this->lastRestart = 0;
+  this->down = false;
+  this->commandSequence = 0;
+  memset(&this->stats, 0, sizeof(this->stats));
+}
+
+Broker::~Broker() {
+  end();
+}
+
+boolean Broker::begin(const char* host, uint16_t port) {
+  this->host = host;
+  this->port = port;
+  this->started = millis();
+  return listen();
+}
+
+boolean Broker::listen() {
+  this->listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (this->listenSocket < 0) return false;
+  int one = 1;
+  setsockopt(this->listenSocket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(this->port);
+  inet_pton(AF_INET, this->host.c_str(), &addr.sin_addr);
+  if (bind(this->listenSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(this->listenSocket, 128) != 0) {
+    ESP_LOGE(TAG, "Failed to listen on %s:%u: %s", this->host.c_str(), this->port, strerror(errno));
+    ::close(this->listenSocket);
+    this->listenSocket = -1;
+    return false;
+  }
+  fcntl(this->listenSocket, F_SETFL, fcntl(this->listenSocket, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void Broker::end() {
+  for (Session* session : this->sessions) {
+    if (session->socket >= 0) ::close(session->socket);
+    delete session;
+  }
+  this->sessions.clear();
+  if (this->listenSocket >= 0) ::close(this->listenSocket);
+  this->listenSocket = -1;
+}
+
+void Broker::restart(uint32_t downMs) {
+  ESP_LOGI(TAG, "Restarting, down for %u ms", downMs);
+  for (Session* session : this->sessions) close(session, false);
+  if (this->listenSocket >= 0) ::close(this->listenSocket);
+  this->listenSocket = -1;
+  // round trips of commands lost with the sessions would never complete
+  this->pendingCommands.clear();
+  this->down = true;
+  this->downUntil = millis() + downMs;
+}
+
+boolean Broker::isDown() {
+  return this->down;
+}
+
+void Broker::poll(uint32_t timeoutMs) {
+  if (this->down && (int32_t)(millis() - this->downUntil) >= 0) {
+    // connections are refused rather than left hanging while the broker is down
+    this->down = false;
+    this->lastRestart = millis() - this->started;
+    if (!listen()) ESP_LOGE(TAG, "Failed to come back up");
+  }
+  std::vector<struct pollfd> fds;
+  if (this->listenSocket >= 0) fds.push_back({ this->listenSocket, POLLIN, 0 });
+  for (Session* session : this->sessions) fds.push_back({ session->socket, POLLIN, 0 });
+  if (::poll(fds.data(), fds.size(), timeoutMs) <= 0) return;
+  size_t i = 0;
+  if (this->listenSocket >= 0 && fds[i++].revents) accept();
+  for (size_t s = 0; i < fds.size(); i++, s++) {
+    if (fds[i].revents && !receive(this->sessions[s])) close(this->sessions[s], true);
+  }
+  for (size_t s = 0; s < this->sessions.size();) {
+    if (this->sessions[s]->socket < 0) {
+      delete this->sessions[s];
+      this->sessions.erase(this->sessions.begin() + s);
+    } else {
+      s++;
+    }
+  }
+}
+
+void Broker::accept() {
+  int socket;
+  while ((socket = ::accept(this->listenSocket, NULL, NULL)) >= 0) {
+    int one = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // writes block, but not forever on a device that stopped reading
+    struct timeval timeout = { 1, 0 };
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    Session* session = new Session();
+    session->socket = socket;
+    session->connected = false;
+    session->deviceId = -1;
+    this->sessions.push_back(session);
+  }
+}
+
+boolean Broker::receive(Session* session) {
+  uint8_t buf[4096];
+  ssize_t n = recv(session->socket, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n == 0) return false;
+  if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+  this->stats.bytesIn += n;
+  session->rx.insert(session->rx.end(), buf, buf + n);
+  while (session->socket >= 0 && session->rx.size() >= 2) {
+    uint32_t length = 0;
+    uint32_t multiplier = 1;
+    size_t pos = 1;
+    boolean complete = false;
+    while (pos < session->rx.size() && pos <= 4) {
+      uint8_t digit = session->rx[pos++];
+      length += (digit & 0x7f) * multiplier;
+      multiplier *= 128;
+      if ((digit & 0x80) == 0) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (pos > 4) return false;
+      break;
+    }
+    if (session->rx.size() < pos + length) break;
+    boolean keep = handlePacket(session, session->rx[0], session->rx.data() + pos, length);
+    if (session->socket >= 0) session->rx.erase(session->rx.begin(), session->rx.begin() + pos + length);
+    if (!keep) return false;
+  }
+  return true;
+}
+
+boolean Broker::handlePacket(Session* session, uint8_t header, const uint8_t* data, uint32_t length) {
+  uint8_t type = header >> 4;
+  if (!session->connected && type != PKT_CONNECT) return false;
+  switch (type) {
+    case PKT_CONNECT:
+      handleConnect(session, data, length);
+      return true;
+    case PKT_PUBLISH:
+      handlePublish(session, header, data, length);
+      return true;
+    case PKT_SUBSCRIBE:
+      handleSubscribe(session, data, length, true);
+      return true;
+    case PKT_UNSUBSCRIBE:
+      handleSubscribe(session, data, length, false);
+      return true;
+    case PKT_PINGREQ:
+      return send(session, PKT_PINGRESP << 4, NULL, 0);
+    case PKT_DISCONNECT:
+      session->willTopic.clear();
+      close(session, false);
+      return true;
+    case PKT_PUBACK:
+      return true;
+    default:
+      ESP_LOGW(TAG, "Unexpected packet type %u", type);
+      return false;
+  }
+}
+
+void Broker::handleConnect(Session* session, const uint8_t* data, uint32_t length) {
+  uint32_t pos = 0;
+  std::string protocol, clientId;
+  if (!readString(data, length, pos, protocol) || pos + 4 > length) {
+    close(session, false);
+    return;
+  }
+  uint8_t flags = data[pos + 1];
+  pos += 4;
+  readString(data, length, pos, clientId);
+  if (flags & 0x04) {
+    readString(data, length, pos, session->willTopic);
+    readString(data, length, pos, session->willMessage);
+  }
+  const uint8_t connack[] = { 0x00, 0x00 };
+  if (!send(session, PKT_CONNACK << 4, connack, sizeof(connack))) return;
+  session->connected = true;
+  this->stats.connects++;
+  this->connectTimes.push_back(millis() - this->started);
+}
+
+void Broker::handleSubscribe(Session* session, const uint8_t* data, uint32_t length, boolean subscribe) {
+  if (length < 2) return;
+  uint32_t pos = 2;
+  std::vector<uint8_t> ack(data, data + 2);
+  std::string filter;
+  while (pos < length && readString(data, length, pos, filter)) {
+    if (subscribe) {
+      pos++;  // requested QoS, everything is delivered with QoS 0
+      ack.push_back(0x00);
+      session->subscriptions.push_back(filter);
+      // <topic>/<deviceId>/down/# identifies the device
+      std::string prefix = this->topic + "/";
+      const std::string suffix = "/down/#";
+      if (filter.compare(0, prefix.size(), prefix) == 0 && filter.size() > prefix.size() + suffix.size()
+        && filter.compare(filter.size() - suffix.size(), suffix.size(), suffix) == 0)
+        session->deviceId = atoi(filter.c_str() + prefix.size());
+    } else {
+      for (size_t i = 0; i < session->subscriptions.size(); i++) {
+        if (session->subscriptions[i] == filter) {
+          session->subscriptions.erase(session->subscriptions.begin() + i);
+          break;
+        }
+      }
+    }
+  }
+  send(session, subscribe ? (PKT_SUBACK << 4) : (PKT_UNSUBACK << 4), ack.data(), subscribe ? ack.size() : 2);
+}
+
+void Broker::handlePublish(Session* session, uint8_t header, const uint8_t* data, uint32_t length) {
+  uint32_t pos = 0;
+  std::string topic;
+  if (!readString(data, length, pos, topic)) return;
+  uint8_t qos = (header >> 1) & 0x03;
+  if (qos > 0) {
+    if (pos + 2 > length) return;
+    send(session, PKT_PUBACK << 4, data + pos, 2);
+    pos += 2;
+  }
+  this->stats.publishesIn++;
+  observe(topic, data + pos, length - pos);
+  route(topic, data + pos, length - pos);
+}
+
+void Broker::observe(const std::string& topic, const uint8_t* payload, uint32_t length) {
+  const std::string sensors = "/up/sensors";
+  const std::string status = "/up/status";
+  if (topic.find(sensors) != std::string::npos) {
+    this->stats.sensorPublishes++;
+  } else if (topic.size() > status.size() && topic.compare(topic.size() - status.size(), status.size(), status) == 0) {
+    this->stats.statusPublishes++;
+    // command results are {"cmd":"..","id":"..","result":".."}
+    std::string message((const char*)payload, length);
+    size_t start = message.find("\"id\":\"");
+    if (start == std::string::npos) return;
+    start += 6;
+    size_t end = message.find('"', start);
+    if (end == std::string::npos) return;
+    auto pending = this->pendingCommands.find(message.substr(start, end - start));
+    if (pending == this->pendingCommands.end()) return;
+    this->commandRtts.push_back(millis() - pending->second);
+    this->stats.commandsAnswered++;
+    this->pendingCommands.erase(pending);
+  }
+}
+
+void Broker::route(const std::string& topic, const uint8_t* payload, uint32_t length) {
+  std::vector<uint8_t> packet;
+  packet.push_back(topic.size() >> 8);
+  packet.push_back(topic.size() & 0xff);
+  packet.insert(packet.end(), topic.begin(), topic.end());
+  packet.insert(packet.end(), payload, payload + length);
+  for (Session* session : this->sessions) {
+    if (session->socket < 0 || !session->connected) continue;
+    for (const std::string& filter : session->subscriptions) {
+      if (matches(filter, topic)) {
+        if (send(session, PKT_PUBLISH << 4, packet.data(), packet.size())) this->stats.publishesOut++;
+        break;
+      }
+    }
+  }
+}
+
+boolean Broker::sendCommand(uint16_t deviceId, const char* command) {
+  char id[16];
+  snprintf(id, sizeof(id), "f%u", ++this->commandSequence);
+  std::string topic = this->topic + "/" + std::to_string(deviceId) + "/down/" + command + "/" + id;
+  for (Session* session : this->sessions) {
+    if (session->socket >= 0 && session->connected && session->deviceId == deviceId) {
+      this->pendingCommands[id] = millis();
+      this->stats.commandsSent++;
+      route(topic, NULL, 0);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<uint16_t> Broker::connectedDevices() {
+  std::vector<uint16_t> devices;
+  for (Session* session : this->sessions) {
+    if (session->socket >= 0 && session->connected && session->deviceId >= 0) devices.push_back(session->deviceId);
+  }
+  return devices;
+}
+
+boolean Broker::send(Session* session, uint8_t header, const uint8_t* data, uint32_t length) {
+  if (session->socket < 0) return false;
+  std::vector<uint8_t> packet;
+  packet.push_back(header);
+  uint32_t remaining = length;
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) digit |= 0x80;
+    packet.push_back(digit);
+  } while (remaining > 0);
+  if (length > 0) packet.insert(packet.end(), data, data + length);
+  size_t sent = 0;
+  while (sent < packet.size()) {
+    ssize_t n = ::send(session->socket, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      close(session, true);
+      return false;
+    }
+    sent += n;
+  }
+  this->stats.bytesOut += packet.size();
+  return true;
+}
+
+void Broker::close(Session* session, boolean publishWill) {
+  if (session->socket < 0) return;
+  ::close(session->socket);
+  session->socket = -1;
+  if (publishWill && session->connected && !session->willTopic.empty()) {
+    route(session->willTopic, (const uint8_t*)session->willMessage.data(), session->willMessage.size());
+  }
+  session->connected = false;
+}
+
+BrokerStats Broker::getStats() {
+  return this->stats;
+}
+
+const std::vector<uint32_t>& Broker::getConnectTimes() {
+  return this->connectTimes;
+}
+
+const std::vector<uint32_t>& Broker::getCommandRtts() {
+  return this->commandRtts;
+}
+
+uint32_t Broker::getLastRestart() {
+  return this->lastRestart;
+}
+
+boolean Broker::matches(const std::string& filter, const std::string& topic) {
+  size_t f = 0, t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') t++;
+      f++;
+      continue;
+    }
+    if (t >= topic.size() || filter[f] != topic[t]) {
+      // "a/#" also matches "a"
+      return t >= topic.size() && filter.compare(f, std::string::npos, "/#") == 0;
+    }
+    f++;
+    t++;
+  }
+  return t == topic.size();
+}
+
+boolean Broker::readString(const uint8_t* data, uint32_t length, uint32_t& pos, std::string& out) {
+  if (pos + 2 > length) return false;
+  uint32_t size = (data[pos] << 8) | data[pos + 1];
+  if (pos + 2 + size > length) return false;
+  out.assign((const char*)data + pos + 2, size);
+  pos += 2 + size;
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef _FLEET_BROKER_H
+#define _FLEET_BROKER_H
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct BrokerStats {
+  uint32_t publishesIn;       // PUBLISH packets received from devices
+  uint32_t sensorPublishes;   // of which on up/sensors
+  uint32_t statusPublishes;   // of which on up/status
+  uint32_t publishesOut;      // PUBLISH packets routed to subscribers
+  uint64_t bytesIn;
+  uint64_t bytesOut;
+  uint32_t connects;          // accepted MQTT sessions
+  uint32_t refused;           // TCP connections refused while down
+  uint32_t commandsSent;
+  uint32_t commandsAnswered;
+};
+
+/**
+ * Just enough of an MQTT 3.1.1 broker for the fleet: CONNECT, SUBSCRIBE, UNSUBSCRIBE, PUBLISH
+ * (QoS 0 routing, QoS 1 acknowledged), PINGREQ, DISCONNECT and last will messages, all served
+ * from one thread with poll(). It also watches the traffic: publishes and bytes, every accepted
+ * connect, and command round trips from a command it sent to a device until the device reports
+ * the result with the same correlation id on up/status.
+ */
+class Broker {
+public:
+  Broker(const char* topic);
+  ~Broker();
+
+  boolean begin(const char* host, uint16_t port);
+  // closes all sockets without sending anything, for forked devices
+  void end();
+
+  // serves the sockets for up to timeoutMs
+  void poll(uint32_t timeoutMs);
+
+  // drops all sessions and refuses connections for downMs, like a broker restart
+  void restart(uint32_t downMs);
+  boolean isDown();
+
+  // sends down/<command>/<id> to the device, false if it isn't connected
+  boolean sendCommand(uint16_t deviceId, const char* command);
+  std::vector<uint16_t> connectedDevices();
+
+  BrokerStats getStats();
+  // connect times in ms since begin(), command round trip times in ms
+  const std::vector<uint32_t>& getConnectTimes();
+  const std::vector<uint32_t>& getCommandRtts();
+  uint32_t getLastRestart();
+
+private:
+  struct Session {
+    int socket;
+    std::vector<uint8_t> rx;
+    boolean connected;
+    int32_t deviceId;
+    std::vector<std::string> subscriptions;
+    std::string willTopic;
+    std::string willMessage;
+  };
+
+  std::string topic;
+  std::string host;
+  uint16_t port;
+  int listenSocket;
+  std::vector<Session*> sessions;
+  uint32_t started;
+  uint32_t downUntil;
+  uint32_t lastRestart;
+  boolean down;
+  uint32_t commandSequence;
+  std::map<std::string, uint32_t> pendingCommands;
+
+  BrokerStats stats;
+  std::vector<uint32_t> connectTimes;
+  std::vector<uint32_t> commandRtts;
+
+  boolean listen();
+  void accept();
+  boolean receive(Session* session);
+  boolean handlePacket(Session* session, uint8_t header, const uint8_t* data, uint32_t length);
+  void handleConnect(Session* session, const uint8_t* data, uint32_t length);
+  void handleSubscribe(Session* session, const uint8_t* data, uint32_t length, boolean subscribe);
+  void handlePublish(Session* session, uint8_t header, const uint8_t* data, uint32_t length);
+  void route(const std::string& topic, const uint8_t* payload, uint32_t length);
+  void observe(const std::string& topic, const uint8_t* payload, uint32_t length);
+  boolean send(Session* session, uint8_t header, const uint8_t* data, uint32_t length);
+  void close(Session* session, boolean publishWill);
+
+  static boolean matches(const std::string& filter, const std::string& topic);
+  static boolean readString(const uint8_t* data, uint32_t length, uint32_t& pos, std::string& out);
+};
+
+#endif
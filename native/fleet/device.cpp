@@ -0,0 +1,88 @@
+#include <device.h>
+#include <globals.h>
+#include <config.h>
+
+#include <configManager.h>
+#include <mqtt.h>
+#include <model.h>
+#include <publishPolicy.h>
+#include <sensorSample.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+namespace Device {
+  Model* model;
+  PublishPolicy publishPolicy;
+  float temperatureOffset = 0;
+
+  void publishMeasurements(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {
+    SensorSample sample;
+    sample.mask = mask;
+    sample.fanPwm = 0;
+    sample.timestamp = millis();
+    sample.data = data;
+    if (publishPolicy.apply(sample, millis()) == M_NONE) return;
+    mqtt::publishSensors(sample);
+  }
+
+  CommandResult calibrateCo2Sensor(uint16_t co2Reference, const char* id) {
+    return CR_OK;
+  }
+
+  CommandResult setTemperatureOffset(float offset, const char* id) {
+    temperatureOffset = offset;
+    return CR_OK;
+  }
+
+  float getTemperatureOffset() {
+    return temperatureOffset;
+  }
+
+  uint32_t getSPS30AutoCleanInterval() {
+    return 0;
+  }
+
+  boolean setSPS30AutoCleanInterval(uint32_t interval) {
+    return false;
+  }
+
+  boolean cleanSPS30() {
+    return false;
+  }
+
+  uint8_t getSPS30Status() {
+    return 0;
+  }
+
+  void configChanged() {
+    model->configurationChanged();
+    mqtt::configurationChanged();
+  }
+
+  void run(uint16_t deviceId, const char* host, uint16_t port, uint32_t intervalMs) {
+    setupConfigManager();
+    getDefaultConfiguration(config);
+    config.deviceId = deviceId;
+    strncpy(config.mqttHost, host, MQTT_HOSTNAME_LEN);
+    config.mqttHost[MQTT_HOSTNAME_LEN] = 0x00;
+    config.mqttServerPort = port;
+    config.mqttUseTls = false;
+
+    model = new Model(publishMeasurements);
+    mqtt::setupMqtt("Fleet", model, calibrateCo2Sensor, setTemperatureOffset, getTemperatureOffset,
+      getSPS30AutoCleanInterval, setSPS30AutoCleanInterval, cleanSPS30, getSPS30Status, configChanged);
+    xTaskCreatePinnedToCore(mqtt::mqttLoop, "mqttLoop", 8192, (void*)1, 2, &mqtt::mqttTask, 0);
+
+    // random walk between 400 and 2000 ppm, seeded per device so the fleet doesn't move in lock step
+    srand(deviceId * 7919 + 1);
+    int32_t co2 = 450 + rand() % 400;
+    uint32_t next = millis() + rand() % intervalMs;
+    while (1) {
+      vTaskDelay(pdMS_TO_TICKS(max((int32_t)0, (int32_t)(next - millis()))));
+      next += intervalMs;
+      co2 = min(2000, max(400, co2 + rand() % 61 - 30));
+      model->updateModel((uint16_t)co2, 21.0f + (rand() % 20) / 10.0f, 45.0f + (rand() % 100) / 10.0f);
+    }
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef _FLEET_DEVICE_H
+#define _FLEET_DEVICE_H
+
+#include <Arduino.h>
+
+namespace Device {
+  /**
+   * Runs one virtual device in the calling process: the real mqtt.cpp against the host WiFi
+   * client and a Model fed by a synthetic CO2 random walk every intervalMs. Never returns.
+   */
+  void run(uint16_t deviceId, const char* host, uint16_t port, uint32_t intervalMs);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include <globals.h>
+#include <broker.h>
+#include <device.h>
+
+#include <getopt.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+// Load generator: N virtual devices, each a forked process with its own mqtt:: state, against a
+// broker stand-in in this process. Usage: program --help
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+// 127.0.0.1 and localhost count as "no broker configured" on the device, any other loopback address works
+#define FLEET_HOST "127.0.0.2"
+
+struct FleetOptions {
+  uint16_t devices = 20;
+  uint32_t durationS = 60;
+  uint32_t intervalMs = 1000;
+  uint32_t commandIntervalMs = 500;
+  uint32_t restartAtS = 20;
+  uint32_t restartForS = 5;
+  uint16_t port = 18830;
+};
+
+void usage(const char* program) {
+  printf("Usage: %s [options]\n"
+    "  --devices N        virtual devices (20)\n"
+    "  --duration S       run time in seconds (60)\n"
+    "  --interval MS      CO2 sample interval per device (1000)\n"
+    "  --commands MS      interval between getConfig commands to a device, 0 disables (500)\n"
+    "  --restart-at S     broker restart after S seconds, 0 disables (20)\n"
+    "  --restart-for S    broker down time in seconds (5)\n"
+    "  --port P           broker port on " FLEET_HOST " (18830)\n", program);
+}
+
+uint32_t percentile(std::vector<uint32_t> values, uint8_t p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+void report(Broker& broker, const FleetOptions& options, uint32_t elapsedMs) {
+  BrokerStats stats = broker.getStats();
+  double seconds = elapsedMs / 1000.0;
+  printf("\n%u devices, %.1f s\n", options.devices, seconds);
+  printf("publishes in:    %8u  %8.1f/s  (sensors %u, status %u)\n", stats.publishesIn, stats.publishesIn / seconds, stats.sensorPublishes, stats.statusPublishes);
+  printf("publishes out:   %8u  %8.1f/s\n", stats.publishesOut, stats.publishesOut / seconds);
+  printf("bytes in/out:    %8lu / %lu\n", (unsigned long)stats.bytesIn, (unsigned long)stats.bytesOut);
+  printf("connects:        %8u\n", stats.connects);
+
+  uint32_t restart = broker.getLastRestart();
+  if (restart > 0) {
+    // connects per second once the broker is back, from the first to the last device
+    std::vector<uint32_t> storm;
+    for (uint32_t t : broker.getConnectTimes()) if (t >= restart) storm.push_back(t - restart);
+    uint32_t buckets[3600] = { 0 };
+    uint32_t peak = 0;
+    for (uint32_t t : storm) peak = std::max(peak, ++buckets[std::min(t / 1000, (uint32_t)3599)]);
+    printf("reconnect storm: %8zu devices back, first after %u ms, last after %u ms, peak %u connects/s\n",
+      storm.size(), storm.empty() ? 0 : percentile(storm, 0), storm.empty() ? 0 : percentile(storm, 100), peak);
+  }
+
+  const std::vector<uint32_t>& rtts = broker.getCommandRtts();
+  printf("commands:        %8u sent, %u answered\n", stats.commandsSent, stats.commandsAnswered);
+  if (!rtts.empty())
+    printf("command rtt ms:  min %u  p50 %u  p95 %u  p99 %u  max %u\n",
+      percentile(rtts, 0), percentile(rtts, 50), percentile(rtts, 95), percentile(rtts, 99), percentile(rtts, 100));
+}
+
+int main(int argc, char** argv) {
+  FleetOptions options;
+  const struct option longOptions[] = {
+    { "devices", required_argument, NULL, 'n' },
+    { "duration", required_argument, NULL, 'd' },
+    { "interval", required_argument, NULL, 'i' },
+    { "commands", required_argument, NULL, 'c' },
+    { "restart-at", required_argument, NULL, 'r' },
+    { "restart-for", required_argument, NULL, 'f' },
+    { "port", required_argument, NULL, 'p' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:d:i:c:r:f:p:h", longOptions, NULL)) != -1) {
+    switch (opt) {
+      case 'n': options.devices = atoi(optarg); break;
+      case 'd': options.durationS = atoi(optarg); break;
+      case 'i': options.intervalMs = max(1, atoi(optarg)); break;
+      case 'c': options.commandIntervalMs = atoi(optarg); break;
+      case 'r': options.restartAtS = atoi(optarg); break;
+      case 'f': options.restartForS = atoi(optarg); break;
+      case 'p': options.port = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  esp_log_level_set("*", ESP_LOG_ERROR);
+  Broker broker("crbox");
+  if (!broker.begin(FLEET_HOST, options.port)) return 1;
+
+  // fork before any task exists, every device gets its own copy of the globals in mqtt.cpp
+  std::vector<pid_t> children;
+  for (uint16_t i = 0; i < options.devices; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      broker.end();
+      Device::run(i + 1, FLEET_HOST, options.port, options.intervalMs);
+      _exit(0);
+    }
+    if (pid < 0) {
+      ESP_LOGE(TAG, "fork failed");
+      break;
+    }
+    children.push_back(pid);
+  }
+
+  uint32_t start = millis();
+  uint32_t lastCommand = start;
+  boolean restarted = options.restartAtS == 0;
+  size_t nextDevice = 0;
+  while (millis() - start < options.durationS * 1000) {
+    broker.poll(10);
+    if (!restarted && millis() - start >= options.restartAtS * 1000) {
+      broker.restart(options.restartForS * 1000);
+      restarted = true;
+    }
+    if (options.commandIntervalMs > 0 && millis() - lastCommand >= options.commandIntervalMs) {
+      lastCommand = millis();
+      std::vector<uint16_t> devices = broker.connectedDevices();
+      if (!devices.empty()) broker.sendCommand(devices[nextDevice++ % devices.size()], "getConfig");
+    }
+  }
+  uint32_t elapsed = millis() - start;
+
+  for (pid_t pid : children) kill(pid, SIGTERM);
+  for (pid_t pid : children) waitpid(pid, NULL, 0);
+  report(broker, options, elapsed);
+  return 0;
+}
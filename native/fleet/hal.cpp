@@ -0,0 +1,129 @@
+#include <globals.h>
+#include <wifiManager.h>
+#include <ota.h>
+#include <i2c.h>
+#include <tlsClient.h>
+
+#include <unistd.h>
+
+// Host stand-ins for the firmware modules mqtt.cpp talks to but the fleet doesn't simulate
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+namespace WifiManager {
+  String getMac() {
+    char mac[18];
+    snprintf(mac, sizeof(mac), "02:00:00:00:%02X:%02X", (getpid() >> 8) & 0xff, getpid() & 0xff);
+    return String(mac);
+  }
+
+  void resetSettings() {
+    ESP_LOGI(TAG, "resetSettings ignored on the host");
+  }
+}
+
+namespace OTA {
+  void checkForUpdate() {
+    ESP_LOGI(TAG, "checkForUpdate ignored on the host");
+  }
+
+  void forceUpdate(const char* url) {
+    ESP_LOGI(TAG, "forceUpdate ignored on the host");
+  }
+}
+
+// -------------------- TLS -------------------
+// There's no mbedTLS on the host, TLS connections always fail so configure devices without TLS
+
+TlsCredentials::TlsCredentials() {
+  this->rootCaLoaded = false;
+  this->clientCertLoaded = false;
+}
+
+TlsCredentials::~TlsCredentials() {}
+
+boolean TlsCredentials::load(const char* rootCaFilename, const char* clientKeyFilename, const char* clientCertFilename) {
+  return true;
+}
+
+boolean TlsCredentials::hasRootCa() {
+  return false;
+}
+
+boolean TlsCredentials::hasClientCert() {
+  return false;
+}
+
+TlsClient::TlsClient(TlsCredentials* credentials, boolean insecure) {
+  this->credentials = credentials;
+  this->insecure = insecure;
+  this->socket = -1;
+  this->configured = false;
+  this->sslConnected = false;
+  this->peeked = -1;
+  this->sessionSaved = false;
+  this->handshakeMs = 0;
+  this->resumed = false;
+}
+
+TlsClient::~TlsClient() {}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  ESP_LOGW(TAG, "TLS is not available on the host");
+  return 0;
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  return connect(IPAddress(), port);
+}
+
+size_t TlsClient::write(uint8_t b) {
+  return 0;
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  return 0;
+}
+
+int TlsClient::available() {
+  return 0;
+}
+
+int TlsClient::read() {
+  return -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  return -1;
+}
+
+int TlsClient::peek() {
+  return -1;
+}
+
+void TlsClient::flush() {}
+
+void TlsClient::stop() {}
+
+uint8_t TlsClient::connected() {
+  return 0;
+}
+
+TlsClient::operator bool() {
+  return false;
+}
+
+void TlsClient::forgetSession() {}
+
+int TlsClient::fd() {
+  return -1;
+}
+
+uint32_t TlsClient::getHandshakeMs() {
+  return 0;
+}
+
+boolean TlsClient::isResumed() {
+  return false;
+}
@@ -0,0 +1,42 @@
+#ifndef _NATIVE_ADAFRUIT_NEOPIXEL_H
+#define _NATIVE_ADAFRUIT_NEOPIXEL_H
+
+#include <Arduino.h>
+
+typedef uint16_t neoPixelType;
+
+#define NEO_GRB     ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGB     ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_KHZ800  0x0000
+
+// Keeps the pixel buffer in memory; show() only counts frames
+class Adafruit_NeoPixel {
+public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800);
+  ~Adafruit_NeoPixel();
+
+  void begin(void) {}
+  void show(void) { shows++; }
+  void clear(void);
+  void setPixelColor(uint16_t n, uint32_t c);
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) { setPixelColor(n, Color(r, g, b)); }
+  uint32_t getPixelColor(uint16_t n) const;
+  void setBrightness(uint8_t b) { brightness = b; }
+  uint8_t getBrightness(void) const { return brightness; }
+  uint16_t numPixels(void) const { return numLEDs; }
+  int16_t getPin(void) const { return pin; }
+  uint32_t getShowCount(void) const { return shows; }
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+
+private:
+  uint16_t numLEDs;
+  int16_t pin;
+  uint8_t brightness;
+  uint32_t shows;
+  uint32_t* pixels;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _NATIVE_ARDUINO_H
+#define _NATIVE_ARDUINO_H
+
+// Host-side stand-in for the ESP32 Arduino core, just enough for the control logic to build on Linux.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/types.h>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <WString.h>
+#include <Print.h>
+#include <Stream.h>
+#include <HardwareSerial.h>
+#include <Esp.h>
+
+using std::min;
+using std::max;
+using std::isnan;
+using std::isinf;
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+#define LOW               0x0
+#define HIGH              0x1
+
+#define INPUT             0x01
+#define OUTPUT            0x03
+#define PULLUP            0x04
+#define INPUT_PULLUP      0x05
+#define PULLDOWN          0x08
+#define INPUT_PULLDOWN    0x09
+
+#define RISING            0x01
+#define FALLING           0x02
+#define CHANGE            0x03
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define EXT_RAM_ATTR
+#define DRAM_ATTR
+
+#define bit(b) (1UL << (b))
+
+#define NATIVE_GPIO_COUNT 49
+#define NATIVE_LEDC_CHANNELS 16
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+const char* pathToFileName(const char* path);
+int ets_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+namespace native {
+  // Drive inputs and trigger attached interrupt handlers from the host side
+  void setDigitalInput(uint8_t pin, uint8_t val);
+}
+
+#endif
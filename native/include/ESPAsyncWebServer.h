@@ -0,0 +1,9 @@
+#ifndef _NATIVE_ESP_ASYNC_WEB_SERVER_H
+#define _NATIVE_ESP_ASYNC_WEB_SERVER_H
+
+// Nothing is served on the host, this only pulls in what the real header brings along
+#include <Arduino.h>
+#include <WiFi.h>
+#include <vector>
+
+#endif
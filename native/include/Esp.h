@@ -0,0 +1,14 @@
+#ifndef _NATIVE_ESP_H
+#define _NATIVE_ESP_H
+
+#include <stdint.h>
+
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _NATIVE_FS_H
+#define _NATIVE_FS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+namespace fs {
+
+  enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+  };
+
+  typedef std::vector<uint8_t> FileContent;
+
+  struct FileImpl {
+    std::string path;
+    std::shared_ptr<FileContent> content;
+    size_t position;
+    bool writable;
+  };
+
+  class File :public Stream {
+  public:
+    File() {}
+    File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override {}
+    size_t read(uint8_t* buf, size_t size);
+    size_t readBytes(char* buffer, size_t length) override { return read((uint8_t*)buffer, length); }
+    bool seek(uint32_t pos, SeekMode mode);
+    bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+    size_t position() const { return impl ? impl->position : 0; }
+    size_t size() const { return impl ? impl->content->size() : 0; }
+    void close() { impl.reset(); }
+    operator bool() const { return (bool)impl; }
+    const char* path() const { return impl ? impl->path.c_str() : nullptr; }
+    const char* name() const;
+
+  private:
+    std::shared_ptr<FileImpl> impl;
+  };
+
+  // In-memory file system shared by all FS instances of the host process
+  class FS {
+  public:
+    File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, const bool create = false) { return open(path.c_str(), mode, create); }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* pathFrom, const char* pathTo);
+    bool rename(const String& pathFrom, const String& pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+    bool mkdir(const char* path) { return true; }
+    bool rmdir(const char* path) { return true; }
+
+  protected:
+    std::map<std::string, std::shared_ptr<FileContent>>& files();
+  };
+
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
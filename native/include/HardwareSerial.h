@@ -0,0 +1,22 @@
+#ifndef _NATIVE_HARDWARE_SERIAL_H
+#define _NATIVE_HARDWARE_SERIAL_H
+
+#include <Stream.h>
+
+// Serial goes to stdout, there is never anything to read
+class HardwareSerial :public Stream {
+public:
+  void begin(unsigned long baud) {}
+  void end() {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  void flush() override;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
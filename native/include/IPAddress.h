@@ -0,0 +1,28 @@
+#ifndef _NATIVE_IPADDRESS_H
+#define _NATIVE_IPADDRESS_H
+
+#include <stdint.h>
+#include <WString.h>
+
+// IPv4 address held in network byte order, like the ESP32 core
+class IPAddress {
+public:
+  IPAddress() { address.dword = 0; }
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { address.bytes[0] = a; address.bytes[1] = b; address.bytes[2] = c; address.bytes[3] = d; }
+  IPAddress(uint32_t dword) { address.dword = dword; }
+
+  operator uint32_t() const { return address.dword; }
+  bool operator==(const IPAddress& other) const { return address.dword == other.address.dword; }
+  uint8_t operator[](int index) const { return address.bytes[index]; }
+
+  bool fromString(const char* text);
+  String toString() const;
+
+private:
+  union {
+    uint8_t bytes[4];
+    uint32_t dword;
+  } address;
+};
+
+#endif
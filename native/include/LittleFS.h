@@ -0,0 +1,24 @@
+#ifndef _NATIVE_LITTLEFS_H
+#define _NATIVE_LITTLEFS_H
+
+#include <FS.h>
+
+namespace fs {
+
+  class LittleFSFS :public FS {
+  public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs") { mounted = true; return true; }
+    bool format() { files().clear(); return true; }
+    size_t totalBytes();
+    size_t usedBytes();
+    void end() { mounted = false; }
+
+  private:
+    bool mounted = false;
+  };
+
+}
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
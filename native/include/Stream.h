@@ -0,0 +1,22 @@
+#ifndef _NATIVE_STREAM_H
+#define _NATIVE_STREAM_H
+
+#include <Print.h>
+
+class Stream :public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+  unsigned long getTimeout(void) { return timeout; }
+
+  virtual size_t readBytes(char* buffer, size_t length);
+  virtual size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+
+protected:
+  unsigned long timeout = 1000;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _NATIVE_TICKER_H
+#define _NATIVE_TICKER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Periodic / one-shot callbacks on a host thread, standing in for the esp_timer backed Ticker
+class Ticker {
+public:
+  typedef void (*callback_t)(void);
+  typedef void (*callback_with_arg_t)(void*);
+
+  Ticker();
+  ~Ticker();
+
+  void attach(float seconds, callback_t callback) { _attach_ms((uint32_t)(seconds * 1000), true, reinterpret_cast<callback_with_arg_t>(callback), nullptr, false); }
+  void attach_ms(uint32_t milliseconds, callback_t callback) { _attach_ms(milliseconds, true, reinterpret_cast<callback_with_arg_t>(callback), nullptr, false); }
+  template<typename TArg>
+  void attach(float seconds, void (*callback)(TArg), TArg arg) {
+    static_assert(sizeof(TArg) <= sizeof(void*), "attach() callback argument size must be <= sizeof(void*)");
+    _attach_ms((uint32_t)(seconds * 1000), true, reinterpret_cast<callback_with_arg_t>(callback), (void*)arg, true);
+  }
+  template<typename TArg>
+  void attach_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg) {
+    static_assert(sizeof(TArg) <= sizeof(void*), "attach_ms() callback argument size must be <= sizeof(void*)");
+    _attach_ms(milliseconds, true, reinterpret_cast<callback_with_arg_t>(callback), (void*)arg, true);
+  }
+  void once(float seconds, callback_t callback) { _attach_ms((uint32_t)(seconds * 1000), false, reinterpret_cast<callback_with_arg_t>(callback), nullptr, false); }
+  void once_ms(uint32_t milliseconds, callback_t callback) { _attach_ms(milliseconds, false, reinterpret_cast<callback_with_arg_t>(callback), nullptr, false); }
+
+  void detach();
+  bool active() const { return running; }
+
+private:
+  void _attach_ms(uint32_t milliseconds, bool repeat, callback_with_arg_t callback, void* arg, bool hasArg);
+
+  std::thread worker;
+  std::mutex lock;
+  std::condition_variable stopped;
+  std::atomic<bool> running;
+  bool stopRequested;
+};
+
+#endif
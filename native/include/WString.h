@@ -0,0 +1,66 @@
+#ifndef _NATIVE_WSTRING_H
+#define _NATIVE_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Minimal Arduino String on top of std::string
+class String {
+public:
+  String(const char* cstr = "") : str(cstr ? cstr : "") {}
+  String(const std::string& s) : str(s) {}
+  String(char c) : str(1, c) {}
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  const char* c_str() const { return str.c_str(); }
+  unsigned int length() const { return (unsigned int)str.length(); }
+  bool reserve(unsigned int size) { str.reserve(size); return true; }
+  bool isEmpty() const { return str.empty(); }
+
+  bool concat(const String& s) { str += s.str; return true; }
+  bool concat(const char* cstr) { if (!cstr) return false; str += cstr; return true; }
+  bool concat(const char* cstr, unsigned int length) { if (!cstr) return false; str.append(cstr, length); return true; }
+  bool concat(char c) { str += c; return true; }
+
+  String& operator+=(const String& rhs) { concat(rhs); return *this; }
+  String& operator+=(const char* cstr) { concat(cstr); return *this; }
+  String& operator+=(char c) { concat(c); return *this; }
+
+  bool equals(const String& s) const { return str == s.str; }
+  bool equals(const char* cstr) const { return str == (cstr ? cstr : ""); }
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+
+  char charAt(unsigned int index) const { return index < str.length() ? str[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  int indexOf(char c) const { size_t pos = str.find(c); return pos == std::string::npos ? -1 : (int)pos; }
+  int indexOf(const char* s) const { size_t pos = str.find(s); return pos == std::string::npos ? -1 : (int)pos; }
+  bool startsWith(const char* prefix) const { return str.rfind(prefix, 0) == 0; }
+  String substring(unsigned int beginIndex) const { return beginIndex < str.length() ? String(str.substr(beginIndex)) : String(); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  long toInt() const;
+  float toFloat() const;
+
+  friend String operator+(const String& lhs, const String& rhs) { String s(lhs); s += rhs; return s; }
+  friend String operator+(const String& lhs, const char* rhs) { String s(lhs); s += rhs; return s; }
+
+protected:
+  std::string str;
+};
+
+// Referenced by ArduinoJson's Arduino String adapter
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* p) : String(p) {}
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _NATIVE_WIFI_H
+#define _NATIVE_WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <WiFiClient.h>
+#include <esp_event.h>
+
+// Station that stays associated unless told otherwise, host names resolve through the host
+class WiFiClass {
+public:
+  bool isConnected() { return connected; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  String macAddress() { return String("00:00:00:00:00:00"); }
+  int8_t RSSI() { return -60; }
+  int hostByName(const char* host, IPAddress& ip);
+
+  // simulates losing and regaining the access point
+  void setConnected(bool connected) { this->connected = connected; }
+
+private:
+  bool connected = true;
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _NATIVE_WIFICLIENT_H
+#define _NATIVE_WIFICLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Plain TCP client on a host socket, non blocking once connected like the ESP32 core's
+class WiFiClient :public Client {
+public:
+  WiFiClient();
+  ~WiFiClient();
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t* buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t* buf, size_t size);
+  int peek();
+  void flush() {}
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected(); }
+  int fd() const { return socket; }
+
+private:
+  int socket;
+  int peeked;
+};
+
+#endif
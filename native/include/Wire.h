@@ -0,0 +1,84 @@
+#ifndef _NATIVE_WIRE_H
+#define _NATIVE_WIRE_H
+
+#include <Arduino.h>
+
+#define I2C_BUFFER_LENGTH 128
+
+// A device model attached to the fake bus. onWrite receives each completed write transaction,
+// onRead fills the buffer for a read transaction and returns the number of bytes provided.
+class NativeI2cDevice {
+public:
+  virtual ~NativeI2cDevice() {}
+  virtual bool onWrite(const uint8_t* data, size_t length) = 0;
+  virtual size_t onRead(uint8_t* data, size_t length) = 0;
+};
+
+// Loopback: every read returns the bytes of the last write, for testing the transport itself
+class NativeI2cLoopback :public NativeI2cDevice {
+public:
+  bool onWrite(const uint8_t* data, size_t length) override;
+  size_t onRead(uint8_t* data, size_t length) override;
+
+private:
+  uint8_t last[I2C_BUFFER_LENGTH];
+  size_t lastLength = 0;
+};
+
+class TwoWire :public Stream {
+public:
+  TwoWire(uint8_t busNum);
+  ~TwoWire();
+
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+  bool end();
+
+  bool setClock(uint32_t frequency);
+  uint32_t getClock();
+  void setTimeOut(uint16_t timeOutMillis) { timeOut = timeOutMillis; }
+  uint16_t getTimeOut() { return timeOut; }
+
+  void beginTransmission(uint16_t address);
+  void beginTransmission(uint8_t address) { beginTransmission((uint16_t)address); }
+  void beginTransmission(int address) { beginTransmission((uint16_t)address); }
+  uint8_t endTransmission(bool sendStop);
+  uint8_t endTransmission(void) { return endTransmission(true); }
+
+  size_t requestFrom(uint16_t address, size_t size, bool sendStop);
+  uint8_t requestFrom(uint16_t address, uint8_t size, bool sendStop) { return (uint8_t)requestFrom(address, (size_t)size, sendStop); }
+  uint8_t requestFrom(uint16_t address, uint8_t size, uint8_t sendStop) { return (uint8_t)requestFrom(address, (size_t)size, sendStop != 0); }
+  uint8_t requestFrom(uint16_t address, uint8_t size) { return requestFrom(address, size, true); }
+  uint8_t requestFrom(uint8_t address, uint8_t size) { return requestFrom((uint16_t)address, size, true); }
+  uint8_t requestFrom(int address, int size) { return requestFrom((uint16_t)address, (uint8_t)size, true); }
+
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* data, size_t quantity) override;
+  int available(void) override;
+  int read(void) override;
+  int peek(void) override;
+  void flush(void) override;
+
+  // host side
+  void attachDevice(uint8_t address, NativeI2cDevice* device);
+  void detachDevice(uint8_t address);
+  NativeI2cDevice* getDevice(uint8_t address);
+  uint32_t getClockChanges() { return clockChanges; }
+
+private:
+  uint8_t num;
+  uint32_t frequency;
+  uint32_t clockChanges;
+  uint16_t timeOut;
+  uint16_t txAddress;
+  uint8_t txBuffer[I2C_BUFFER_LENGTH];
+  size_t txLength;
+  uint8_t rxBuffer[I2C_BUFFER_LENGTH];
+  size_t rxIndex;
+  size_t rxLength;
+  NativeI2cDevice* devices[128];
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _NATIVE_DRIVER_PCNT_H
+#define _NATIVE_DRIVER_PCNT_H
+
+#include <stdint.h>
+#include <esp_err.h>
+
+typedef enum {
+  PCNT_UNIT_0,
+  PCNT_UNIT_1,
+  PCNT_UNIT_2,
+  PCNT_UNIT_3,
+  PCNT_UNIT_MAX
+} pcnt_unit_t;
+
+typedef enum {
+  PCNT_CHANNEL_0,
+  PCNT_CHANNEL_1,
+  PCNT_CHANNEL_MAX
+} pcnt_channel_t;
+
+typedef enum {
+  PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+  PCNT_CHANNEL_LEVEL_ACTION_INVERSE,
+  PCNT_CHANNEL_LEVEL_ACTION_HOLD
+} pcnt_ctrl_mode_t;
+
+typedef enum {
+  PCNT_CHANNEL_EDGE_ACTION_HOLD,
+  PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+  PCNT_CHANNEL_EDGE_ACTION_DECREASE
+} pcnt_count_mode_t;
+
+typedef struct {
+  int pulse_gpio_num;
+  int ctrl_gpio_num;
+  pcnt_ctrl_mode_t lctrl_mode;
+  pcnt_ctrl_mode_t hctrl_mode;
+  pcnt_count_mode_t pos_mode;
+  pcnt_count_mode_t neg_mode;
+  int16_t counter_h_lim;
+  int16_t counter_l_lim;
+  pcnt_unit_t unit;
+  pcnt_channel_t channel;
+} pcnt_config_t;
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* pcnt_config);
+esp_err_t pcnt_get_counter_value(pcnt_unit_t pcnt_unit, int16_t* count);
+esp_err_t pcnt_counter_pause(pcnt_unit_t pcnt_unit);
+esp_err_t pcnt_counter_resume(pcnt_unit_t pcnt_unit);
+esp_err_t pcnt_counter_clear(pcnt_unit_t pcnt_unit);
+
+namespace native {
+  // Simulate tacho pulses arriving on a counter unit
+  void pcntAddPulses(pcnt_unit_t pcnt_unit, int16_t pulses);
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _NATIVE_ESP_EVENT_H
+#define _NATIVE_ESP_EVENT_H
+
+#include <stdint.h>
+
+// Event ids only, nothing is dispatched on the host
+typedef const char* esp_event_base_t;
+
+extern esp_event_base_t const WIFI_EVENT;
+extern esp_event_base_t const IP_EVENT;
+
+typedef enum {
+  IP_EVENT_STA_GOT_IP,
+  IP_EVENT_STA_LOST_IP
+} ip_event_t;
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef _NATIVE_ESP_LOG_H
+#define _NATIVE_ESP_LOG_H
+
+#include <stdarg.h>
+
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char*, va_list);
+
+void esp_log_level_set(const char* tag, esp_log_level_t level);
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+void esp_log_writev(esp_log_level_t level, const char* tag, const char* format, va_list args);
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...);
+
+#endif
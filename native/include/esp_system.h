@@ -0,0 +1,11 @@
+#ifndef _NATIVE_ESP_SYSTEM_H
+#define _NATIVE_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+uint32_t esp_random(void);
+
+#endif
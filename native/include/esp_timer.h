@@ -0,0 +1,9 @@
+#ifndef _NATIVE_ESP_TIMER_H
+#define _NATIVE_ESP_TIMER_H
+
+#include <stdint.h>
+
+// Microseconds since the host process started, like the ESP-IDF high resolution timer
+int64_t esp_timer_get_time(void);
+
+#endif
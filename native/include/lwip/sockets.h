@@ -0,0 +1,11 @@
+#ifndef _NATIVE_LWIP_SOCKETS_H
+#define _NATIVE_LWIP_SOCKETS_H
+
+// BSD sockets of the host, lwIP offers the same calls on the ESP32
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _NATIVE_MBEDTLS_PK_H
+#define _NATIVE_MBEDTLS_PK_H
+
+typedef struct { int unused; } mbedtls_pk_context;
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _NATIVE_MBEDTLS_SSL_H
+#define _NATIVE_MBEDTLS_SSL_H
+
+// Types only so tlsClient.h parses on the host, there is no TLS implementation behind them
+#include <stddef.h>
+
+typedef struct { int unused; } mbedtls_ssl_config;
+typedef struct { int unused; } mbedtls_ssl_context;
+typedef struct { int unused; } mbedtls_ssl_session;
+
+#endif
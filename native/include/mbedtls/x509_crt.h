@@ -0,0 +1,6 @@
+#ifndef _NATIVE_MBEDTLS_X509_CRT_H
+#define _NATIVE_MBEDTLS_X509_CRT_H
+
+typedef struct { int unused; } mbedtls_x509_crt;
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _NATIVE_SDKCONFIG_H
+#define _NATIVE_SDKCONFIG_H
+
+// Host build mimics the default esp32-s3 environment
+#define CONFIG_IDF_TARGET_ESP32S3 1
+#define CONFIG_FREERTOS_HZ 1000
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _MQTT_TEST_PUBSUBCLIENT_H
+#define _MQTT_TEST_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+struct RecordedPublish {
+  std::string topic;
+  std::string payload;
+  uint32_t ms;   // millis() when published
+};
+
+/**
+ * Stands in for knolleary/PubSubClient: connects without touching the network and records every
+ * publish. The records are shared by all instances and safe to read from another task.
+ */
+class PubSubClient {
+public:
+  PubSubClient(Client& client);
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  boolean setBufferSize(uint16_t size);
+  PubSubClient& setKeepAlive(uint16_t keepAlive);
+
+  boolean connect(const char* id, const char* user, const char* pass);
+  boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
+  void disconnect();
+  boolean publish(const char* topic, const char* payload);
+  boolean publish(const char* topic, const uint8_t* payload, unsigned int length);
+  boolean subscribe(const char* topic);
+  boolean unsubscribe(const char* topic);
+  boolean loop();
+  boolean connected();
+  int state();
+
+  // test side
+  static std::vector<RecordedPublish> getPublishes(const char* topic);
+  static void clearPublishes();
+  static uint32_t getConnects();
+
+private:
+  uint16_t bufferSize;
+  int currentState;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include <globals.h>
+#include <config.h>
+
+#include <configManager.h>
+#include <latency.h>
+#include <mqtt.h>
+#include <model.h>
+#include <sensorSample.h>
+#include <PubSubClient.h>
+
+#include <ArduinoJson.h>
+
+// Host test of the sensor batching: samples go through mqtt::publishSensors() and the mqtt task of
+// the real mqtt.cpp to a recording PubSubClient. Exits with 1 if a check fails.
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+#define TEST_BATCH_SIZE 5
+#define TEST_BATCH_INTERVAL_S 2
+// long enough for the mqtt task to take each sample out of its slot before the next one
+#define TEST_SAMPLE_SPACING_MS 50
+// how late a publish may be, the task wakes on a notification or the batch deadline
+#define TEST_SLACK_MS 100
+
+uint32_t failedChecks = 0;
+
+void check(boolean ok, const char* what) {
+  printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failedChecks++;
+}
+
+void modelUpdated(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {}
+
+CommandResult calibrateCo2Sensor(uint16_t co2Reference, const char* id) { return CR_OK; }
+CommandResult setTemperatureOffset(float offset, const char* id) { return CR_OK; }
+float getTemperatureOffset() { return 0; }
+uint32_t getSPS30AutoCleanInterval() { return 0; }
+boolean setSPS30AutoCleanInterval(uint32_t interval) { return false; }
+boolean cleanSPS30() { return false; }
+uint8_t getSPS30Status() { return 0; }
+void configChanged() {}
+
+// one CO2 reading, returns the time it was taken
+uint32_t publishSample(uint16_t co2) {
+  SensorSample sample = {};
+  sample.mask = M_CO2;
+  sample.timestamp = millis();
+  sample.data.co2 = co2;
+  sample.data.updated = Latency::now();
+  mqtt::publishSensors(sample);
+  return sample.timestamp;
+}
+
+// checks that the publish carries count samples with CO2 400 + first..., in the order they were taken
+// and with their age at the time of the publish
+void checkBatch(const RecordedPublish& publish, const uint32_t* timestamps, uint8_t count, uint16_t first) {
+  DynamicJsonDocument doc(SENSOR_BATCH_JSON_SIZE * 2);
+  check(!deserializeJson(doc, publish.payload.c_str()) && doc.is<JsonArray>(), "  payload is a JSON array");
+  JsonArray entries = doc.as<JsonArray>();
+  check(entries.size() == count, "  one entry per sample");
+  boolean values = true;
+  boolean ages = true;
+  for (uint8_t i = 0; i < min((uint8_t)entries.size(), count); i++) {
+    JsonObject entry = entries[i];
+    if (entry["co2"].as<uint16_t>() != 400 + first + i) values = false;
+    uint32_t expected = publish.ms - timestamps[i];
+    // serialised a moment before it was recorded
+    if (!entry.containsKey("age") || entry["age"].as<uint32_t>() > expected || entry["age"].as<uint32_t>() + 5 < expected) ages = false;
+  }
+  check(values, "  samples in the order they were taken");
+  check(ages, "  every sample timestamped with its age");
+}
+
+int main(int argc, char** argv) {
+  esp_log_level_set("*", ESP_LOG_WARN);
+  setupConfigManager();
+  getDefaultConfiguration(config);
+  // 127.0.0.1 and localhost count as "no broker configured"
+  strncpy(config.mqttHost, "broker.test", MQTT_HOSTNAME_LEN);
+  config.mqttUseTls = false;
+  config.sensorsBatchSize = TEST_BATCH_SIZE;
+  config.sensorsBatchInterval = TEST_BATCH_INTERVAL_S;
+  char topic[MQTT_TOPIC_LEN + 40];
+  snprintf(topic, sizeof(topic), "%s/%u/up/sensors", config.mqttTopic, config.deviceId);
+
+  Model* model = new Model(modelUpdated);
+  mqtt::setupMqtt("MqttTest", model, calibrateCo2Sensor, setTemperatureOffset, getTemperatureOffset,
+    getSPS30AutoCleanInterval, setSPS30AutoCleanInterval, cleanSPS30, getSPS30Status, configChanged);
+  xTaskCreatePinnedToCore(mqtt::mqttLoop, "mqttLoop", 8192, (void*)1, 2, &mqtt::mqttTask, 0);
+  uint32_t start = millis();
+  while (PubSubClient::getConnects() == 0 && millis() - start < 2000) delay(10);
+  check(PubSubClient::getConnects() == 1, "mqtt task connected");
+
+  printf("%u samples with batch size %u:\n", TEST_BATCH_SIZE, TEST_BATCH_SIZE);
+  PubSubClient::clearPublishes();
+  uint32_t timestamps[TEST_BATCH_SIZE];
+  for (uint8_t i = 0; i < TEST_BATCH_SIZE; i++) {
+    timestamps[i] = publishSample(400 + i);
+    delay(TEST_SAMPLE_SPACING_MS);
+  }
+  delay(TEST_SLACK_MS);
+  std::vector<RecordedPublish> publishes = PubSubClient::getPublishes(topic);
+  check(publishes.size() == 1, "  exactly one publish");
+  if (publishes.size() == 1) {
+    checkBatch(publishes[0], timestamps, TEST_BATCH_SIZE, 0);
+    check(publishes[0].ms - timestamps[TEST_BATCH_SIZE - 1] <= TEST_SLACK_MS, "  published when the batch was full");
+  }
+
+  printf("2 samples with batch interval %u s:\n", TEST_BATCH_INTERVAL_S);
+  PubSubClient::clearPublishes();
+  for (uint8_t i = 0; i < 2; i++) {
+    timestamps[i] = publishSample(410 + i);
+    delay(TEST_SAMPLE_SPACING_MS);
+  }
+  delay(timestamps[0] + TEST_BATCH_INTERVAL_S * 1000 - TEST_SLACK_MS - millis());
+  check(PubSubClient::getPublishes(topic).size() == 0, "  nothing published before the interval");
+  delay(2 * TEST_SLACK_MS);
+  publishes = PubSubClient::getPublishes(topic);
+  check(publishes.size() == 1, "  exactly one publish");
+  if (publishes.size() == 1) {
+    checkBatch(publishes[0], timestamps, 2, 10);
+    uint32_t age = publishes[0].ms - timestamps[0];
+    check(age >= TEST_BATCH_INTERVAL_S * 1000 && age <= TEST_BATCH_INTERVAL_S * 1000 + TEST_SLACK_MS, "  flushed on the batch interval");
+  }
+
+  if (failedChecks != 0) {
+    printf("%u check(s) failed\n", failedChecks);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include <PubSubClient.h>
+
+#include <mutex>
+
+static std::mutex recordMutex;
+static std::vector<RecordedPublish> publishes;
+static uint32_t connects = 0;
+
+PubSubClient::PubSubClient(Client& client) {
+  this->bufferSize = 256;
+  this->currentState = MQTT_DISCONNECTED;
+}
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  return *this;
+}
+
+boolean PubSubClient::setBufferSize(uint16_t size) {
+  this->bufferSize = size;
+  return true;
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t keepAlive) {
+  return *this;
+}
+
+boolean PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  return connect(id, user, pass, NULL, 0, false, NULL);
+}
+
+boolean PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  connects++;
+  this->currentState = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  this->currentState = MQTT_DISCONNECTED;
+}
+
+boolean PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, strlen(payload));
+}
+
+// like the library, a message that doesn't fit the buffer with its header isn't sent
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length) {
+  if (!connected() || 5 + 2 + strlen(topic) + length > this->bufferSize) return false;
+  std::lock_guard<std::mutex> lock(recordMutex);
+  publishes.push_back({ topic, std::string((const char*)payload, length), millis() });
+  return true;
+}
+
+boolean PubSubClient::subscribe(const char* topic) {
+  return connected();
+}
+
+boolean PubSubClient::unsubscribe(const char* topic) {
+  return connected();
+}
+
+boolean PubSubClient::loop() {
+  return connected();
+}
+
+boolean PubSubClient::connected() {
+  return this->currentState == MQTT_CONNECTED;
+}
+
+int PubSubClient::state() {
+  return this->currentState;
+}
+
+std::vector<RecordedPublish> PubSubClient::getPublishes(const char* topic) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  std::vector<RecordedPublish> result;
+  for (const RecordedPublish& publish : publishes) {
+    if (publish.topic == topic) result.push_back(publish);
+  }
+  return result;
+}
+
+void PubSubClient::clearPublishes() {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  publishes.clear();
+}
+
+uint32_t PubSubClient::getConnects() {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  return connects;
+}
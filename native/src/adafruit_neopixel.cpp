@@ -0,0 +1,22 @@
+#include <Adafruit_NeoPixel.h>
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t _pin, neoPixelType type) :
+  numLEDs(n), pin(_pin), brightness(0), shows(0) {
+  pixels = new uint32_t[n == 0 ? 1 : n]();
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel() {
+  delete[] pixels;
+}
+
+void Adafruit_NeoPixel::clear(void) {
+  for (uint16_t i = 0; i < numLEDs; i++) pixels[i] = 0;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+  if (n < numLEDs) pixels[n] = c;
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const {
+  return n < numLEDs ? pixels[n] : 0;
+}
@@ -0,0 +1,283 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+  const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+  std::mutex gpioLock;
+  uint8_t pinModes[NATIVE_GPIO_COUNT] = { 0 };
+  uint8_t pinLevels[NATIVE_GPIO_COUNT] = { 0 };
+  void (*pinHandlers[NATIVE_GPIO_COUNT])(void) = { nullptr };
+  int pinInterruptModes[NATIVE_GPIO_COUNT] = { 0 };
+
+  uint32_t ledcDuty[NATIVE_LEDC_CHANNELS] = { 0 };
+
+  esp_log_level_t logLevel = ESP_LOG_INFO;
+  vprintf_like_t logVprintf = vprintf;
+}
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// -------------------- time -------------------
+
+int64_t esp_timer_get_time(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+uint32_t millis() {
+  return (uint32_t)(esp_timer_get_time() / 1000ULL);
+}
+
+uint32_t micros() {
+  return (uint32_t)esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+// -------------------- gpio / ledc -------------------
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  pinModes[pin] = mode;
+  if (mode == INPUT_PULLUP) pinLevels[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  pinLevels[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= NATIVE_GPIO_COUNT) return LOW;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  return pinLevels[pin];
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  pinHandlers[pin] = handler;
+  pinInterruptModes[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin >= NATIVE_GPIO_COUNT) return;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  pinHandlers[pin] = nullptr;
+}
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits) {
+  return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {}
+
+void ledcDetachPin(uint8_t pin) {}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+  if (channel >= NATIVE_LEDC_CHANNELS) return;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  ledcDuty[channel] = duty;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+  if (channel >= NATIVE_LEDC_CHANNELS) return 0;
+  std::lock_guard<std::mutex> guard(gpioLock);
+  return ledcDuty[channel];
+}
+
+namespace native {
+  void setDigitalInput(uint8_t pin, uint8_t val) {
+    if (pin >= NATIVE_GPIO_COUNT) return;
+    void (*handler)(void) = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(gpioLock);
+      uint8_t old = pinLevels[pin];
+      pinLevels[pin] = val ? HIGH : LOW;
+      int mode = pinInterruptModes[pin];
+      if (pinHandlers[pin] && old != pinLevels[pin]
+        && (mode == CHANGE || (mode == RISING && pinLevels[pin]) || (mode == FALLING && !pinLevels[pin])))
+        handler = pinHandlers[pin];
+    }
+    if (handler) handler();
+  }
+}
+
+// -------------------- system / logging -------------------
+
+void esp_restart(void) {
+  fprintf(stderr, "esp_restart() called\n");
+  exit(0);
+}
+
+uint32_t esp_get_free_heap_size(void) {
+  return 0xffffffff;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+  return 0xffffffff;
+}
+
+uint32_t esp_random(void) {
+  static thread_local std::mt19937 generator(std::random_device{}());
+  return (uint32_t)generator();
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return esp_get_free_heap_size();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return esp_get_minimum_free_heap_size();
+}
+
+const char* pathToFileName(const char* path) {
+  const char* name = strrchr(path, '/');
+  return name ? name + 1 : path;
+}
+
+int ets_printf(const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int len = vprintf(fmt, args);
+  va_end(args);
+  return len;
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+  logLevel = level;
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func) {
+  vprintf_like_t old = logVprintf;
+  logVprintf = func;
+  return old;
+}
+
+void esp_log_writev(esp_log_level_t level, const char* tag, const char* format, va_list args) {
+  if (level > logLevel) return;
+  logVprintf(format, args);
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  esp_log_writev(level, tag, format, args);
+  va_end(args);
+}
+
+// -------------------- String / Print / Stream -------------------
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) {
+  char buf[34];
+  if (base == 16) snprintf(buf, sizeof(buf), "%lx", value);
+  else snprintf(buf, sizeof(buf), "%ld", value);
+  str = buf;
+}
+
+String::String(unsigned long value, unsigned char base) {
+  char buf[34];
+  if (base == 16) snprintf(buf, sizeof(buf), "%lx", value);
+  else snprintf(buf, sizeof(buf), "%lu", value);
+  str = buf;
+}
+
+String::String(float value, unsigned int decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  str = buf;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) std::swap(beginIndex, endIndex);
+  if (beginIndex >= str.length()) return String();
+  return String(str.substr(beginIndex, endIndex - beginIndex));
+}
+
+long String::toInt() const {
+  return atol(str.c_str());
+}
+
+float String::toFloat() const {
+  return (float)atof(str.c_str());
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buf[64];
+  char* temp = buf;
+  va_list arg;
+  va_start(arg, format);
+  int len = vsnprintf(temp, sizeof(buf), format, arg);
+  va_end(arg);
+  if (len < 0) return 0;
+  if ((size_t)len >= sizeof(buf)) {
+    temp = (char*)malloc(len + 1);
+    if (temp == NULL) return 0;
+    va_start(arg, format);
+    vsnprintf(temp, len + 1, format, arg);
+    va_end(arg);
+  }
+  len = write((uint8_t*)temp, len);
+  if (temp != buf) free(temp);
+  return len;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  uint32_t start = millis();
+  while (count < length) {
+    int c = read();
+    if (c < 0) {
+      if (millis() - start >= timeout) break;
+      yield();
+      continue;
+    }
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
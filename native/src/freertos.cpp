@@ -0,0 +1,342 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct NativeTask {
+  std::string name;
+  std::thread thread;
+  UBaseType_t priority;
+  BaseType_t core;
+  uint32_t stackSize;
+  volatile eTaskState state;
+
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notificationValue;
+  bool notificationPending;
+};
+
+struct NativeQueue {
+  size_t length;
+  size_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+  std::mutex lock;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+};
+
+struct NativeSemaphore {
+  UBaseType_t maxCount;
+  UBaseType_t count;
+  std::mutex lock;
+  std::condition_variable available;
+};
+
+namespace {
+  thread_local NativeTask* currentTask = nullptr;
+
+  std::mutex criticalLock;
+
+  // Waits on cv until pred holds or the tick timeout expires, portMAX_DELAY blocks forever
+  template <typename P>
+  bool waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, P pred) {
+    if (ticks == portMAX_DELAY) {
+      cv.wait(lock, pred);
+      return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(pdTICKS_TO_MS(ticks)), pred);
+  }
+
+  void taskTrampoline(NativeTask* task, TaskFunction_t pvTaskCode, void* pvParameters) {
+    currentTask = task;
+    task->state = eRunning;
+    pvTaskCode(pvParameters);
+    task->state = eDeleted;
+  }
+}
+
+// -------------------- critical sections -------------------
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+  criticalLock.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+  criticalLock.unlock();
+}
+
+// -------------------- tasks -------------------
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters,
+  UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask, BaseType_t xCoreID) {
+  NativeTask* task = new NativeTask();
+  task->name = pcName ? pcName : "";
+  task->priority = uxPriority;
+  task->core = xCoreID;
+  task->stackSize = usStackDepth;
+  task->state = eReady;
+  task->notificationValue = 0;
+  task->notificationPending = false;
+  // publish the handle before the task runs, task code commonly relies on it
+  if (pvCreatedTask) *pvCreatedTask = task;
+  task->thread = std::thread(taskTrampoline, task, pvTaskCode, pvParameters);
+  task->thread.detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters,
+  UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask) {
+  return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+  NativeTask* task = xTaskToDelete ? xTaskToDelete : xTaskGetCurrentTaskHandle();
+  task->state = eDeleted;
+  // A thread can only end itself, deleting another task just marks it
+  if (task == currentTask) pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(pdTICKS_TO_MS(xTicksToDelay)));
+}
+
+TickType_t xTaskGetTickCount(void) {
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return (TickType_t)pdMS_TO_TICKS(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  if (!currentTask) {
+    // threads not created through xTaskCreate (e.g. main) get a handle on first use
+    currentTask = new NativeTask();
+    currentTask->name = "main";
+    currentTask->priority = 1;
+    currentTask->core = tskNO_AFFINITY;
+    currentTask->stackSize = 0;
+    currentTask->state = eRunning;
+    currentTask->notificationValue = 0;
+    currentTask->notificationPending = false;
+  }
+  return currentTask;
+}
+
+char* pcTaskGetTaskName(TaskHandle_t xTaskToQuery) {
+  NativeTask* task = xTaskToQuery ? xTaskToQuery : xTaskGetCurrentTaskHandle();
+  return (char*)task->name.c_str();
+}
+
+char* pcTaskGetName(TaskHandle_t xTaskToQuery) {
+  return pcTaskGetTaskName(xTaskToQuery);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+  NativeTask* task = xTask ? xTask : xTaskGetCurrentTaskHandle();
+  return task->stackSize;
+}
+
+eTaskState eTaskGetState(TaskHandle_t xTask) {
+  if (!xTask) return eInvalid;
+  return xTask->state;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t xTask) {
+  NativeTask* task = xTask ? xTask : xTaskGetCurrentTaskHandle();
+  return task->core;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction) {
+  if (!xTaskToNotify) return pdFAIL;
+  std::lock_guard<std::mutex> guard(xTaskToNotify->lock);
+  switch (eAction) {
+    case eSetBits: xTaskToNotify->notificationValue |= ulValue; break;
+    case eIncrement: xTaskToNotify->notificationValue++; break;
+    case eSetValueWithOverwrite: xTaskToNotify->notificationValue = ulValue; break;
+    case eSetValueWithoutOverwrite:
+      if (xTaskToNotify->notificationPending) return pdFAIL;
+      xTaskToNotify->notificationValue = ulValue;
+      break;
+    default: break;
+  }
+  xTaskToNotify->notificationPending = true;
+  xTaskToNotify->notified.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t* pxHigherPriorityTaskWoken) {
+  if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+  return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t* pulNotificationValue, TickType_t xTicksToWait) {
+  NativeTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->lock);
+  if (!task->notificationPending) task->notificationValue &= ~ulBitsToClearOnEntry;
+  bool received = waitFor(task->notified, lock, xTicksToWait, [task] { return task->notificationPending; });
+  if (pulNotificationValue) *pulNotificationValue = task->notificationValue;
+  if (!received) return pdFAIL;
+  task->notificationValue &= ~ulBitsToClearOnExit;
+  task->notificationPending = false;
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+  return xTaskNotify(xTaskToNotify, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+  NativeTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->lock);
+  waitFor(task->notified, lock, xTicksToWait, [task] { return task->notificationValue != 0; });
+  uint32_t value = task->notificationValue;
+  if (value != 0) {
+    if (xClearCountOnExit) task->notificationValue = 0;
+    else task->notificationValue--;
+  }
+  task->notificationPending = false;
+  return value;
+}
+
+// -------------------- queues -------------------
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+  if (uxQueueLength == 0) return NULL;
+  NativeQueue* queue = new NativeQueue();
+  queue->length = uxQueueLength;
+  queue->itemSize = uxItemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue) {
+  delete xQueue;
+}
+
+static BaseType_t queueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait, bool toFront) {
+  if (!xQueue) return errQUEUE_FULL;
+  std::unique_lock<std::mutex> lock(xQueue->lock);
+  if (!waitFor(xQueue->notFull, lock, xTicksToWait, [xQueue] { return xQueue->items.size() < xQueue->length; }))
+    return errQUEUE_FULL;
+  std::vector<uint8_t> item((const uint8_t*)pvItemToQueue, (const uint8_t*)pvItemToQueue + xQueue->itemSize);
+  if (toFront) xQueue->items.push_front(std::move(item));
+  else xQueue->items.push_back(std::move(item));
+  xQueue->notEmpty.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait) {
+  return queueSend(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait) {
+  return queueSend(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t xQueue, const void* pvItemToQueue, BaseType_t* pxHigherPriorityTaskWoken) {
+  if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+  return queueSend(xQueue, pvItemToQueue, 0, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void* pvItemToQueue) {
+  if (!xQueue) return pdFAIL;
+  std::lock_guard<std::mutex> guard(xQueue->lock);
+  xQueue->items.clear();
+  xQueue->items.emplace_back((const uint8_t*)pvItemToQueue, (const uint8_t*)pvItemToQueue + xQueue->itemSize);
+  xQueue->notEmpty.notify_all();
+  return pdPASS;
+}
+
+static BaseType_t queueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait, bool remove) {
+  if (!xQueue) return errQUEUE_EMPTY;
+  std::unique_lock<std::mutex> lock(xQueue->lock);
+  if (!waitFor(xQueue->notEmpty, lock, xTicksToWait, [xQueue] { return !xQueue->items.empty(); }))
+    return errQUEUE_EMPTY;
+  memcpy(pvBuffer, xQueue->items.front().data(), xQueue->itemSize);
+  if (remove) {
+    xQueue->items.pop_front();
+    xQueue->notFull.notify_all();
+  }
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+  return queueReceive(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+  return queueReceive(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+  if (!xQueue) return 0;
+  std::lock_guard<std::mutex> guard(xQueue->lock);
+  return (UBaseType_t)xQueue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue) {
+  if (!xQueue) return 0;
+  std::lock_guard<std::mutex> guard(xQueue->lock);
+  return (UBaseType_t)(xQueue->length - xQueue->items.size());
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue) {
+  if (!xQueue) return pdFAIL;
+  std::lock_guard<std::mutex> guard(xQueue->lock);
+  xQueue->items.clear();
+  xQueue->notFull.notify_all();
+  return pdPASS;
+}
+
+// -------------------- semaphores -------------------
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount) {
+  NativeSemaphore* semaphore = new NativeSemaphore();
+  semaphore->maxCount = uxMaxCount;
+  semaphore->count = uxInitialCount;
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return xSemaphoreCreateCounting(1, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
+  delete xSemaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait) {
+  if (!xSemaphore) return pdFALSE;
+  std::unique_lock<std::mutex> lock(xSemaphore->lock);
+  if (!waitFor(xSemaphore->available, lock, xTicksToWait, [xSemaphore] { return xSemaphore->count > 0; }))
+    return pdFALSE;
+  xSemaphore->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+  if (!xSemaphore) return pdFALSE;
+  std::lock_guard<std::mutex> guard(xSemaphore->lock);
+  if (xSemaphore->count >= xSemaphore->maxCount) return pdFALSE;
+  xSemaphore->count++;
+  xSemaphore->available.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t* pxHigherPriorityTaskWoken) {
+  if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+  return xSemaphoreGive(xSemaphore);
+}
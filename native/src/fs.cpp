@@ -0,0 +1,133 @@
+#include <FS.h>
+#include <LittleFS.h>
+
+#include <mutex>
+
+fs::LittleFSFS LittleFS;
+
+namespace {
+  std::mutex fsLock;
+}
+
+namespace fs {
+
+  // -------------------- File -------------------
+
+  size_t File::write(const uint8_t* buf, size_t size) {
+    if (!impl || !impl->writable) return 0;
+    std::lock_guard<std::mutex> guard(fsLock);
+    FileContent& content = *impl->content;
+    if (impl->position + size > content.size()) content.resize(impl->position + size);
+    memcpy(content.data() + impl->position, buf, size);
+    impl->position += size;
+    return size;
+  }
+
+  int File::available() {
+    if (!impl) return 0;
+    std::lock_guard<std::mutex> guard(fsLock);
+    return (int)(impl->content->size() - impl->position);
+  }
+
+  int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int File::peek() {
+    if (!impl) return -1;
+    std::lock_guard<std::mutex> guard(fsLock);
+    if (impl->position >= impl->content->size()) return -1;
+    return (*impl->content)[impl->position];
+  }
+
+  size_t File::read(uint8_t* buf, size_t size) {
+    if (!impl) return 0;
+    std::lock_guard<std::mutex> guard(fsLock);
+    const FileContent& content = *impl->content;
+    if (impl->position >= content.size()) return 0;
+    size_t n = min(size, content.size() - impl->position);
+    memcpy(buf, content.data() + impl->position, n);
+    impl->position += n;
+    return n;
+  }
+
+  bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl) return false;
+    std::lock_guard<std::mutex> guard(fsLock);
+    size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? impl->position : impl->content->size());
+    if (base + pos > impl->content->size()) return false;
+    impl->position = base + pos;
+    return true;
+  }
+
+  const char* File::name() const {
+    if (!impl) return nullptr;
+    const char* name = strrchr(impl->path.c_str(), '/');
+    return name ? name + 1 : impl->path.c_str();
+  }
+
+  // -------------------- FS -------------------
+
+  std::map<std::string, std::shared_ptr<FileContent>>& FS::files() {
+    static std::map<std::string, std::shared_ptr<FileContent>> files;
+    return files;
+  }
+
+  File FS::open(const char* path, const char* mode, const bool create) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    std::map<std::string, std::shared_ptr<FileContent>>& all = files();
+    std::map<std::string, std::shared_ptr<FileContent>>::iterator it = all.find(path);
+    std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    impl->position = 0;
+    impl->writable = mode[0] != 'r' || mode[1] == '+';
+    if (mode[0] == 'r') {
+      if (it == all.end()) return File();
+      impl->content = it->second;
+    } else if (mode[0] == 'w') {
+      impl->content = std::make_shared<FileContent>();
+      all[path] = impl->content;
+    } else {
+      if (it == all.end()) it = all.emplace(path, std::make_shared<FileContent>()).first;
+      impl->content = it->second;
+      impl->position = impl->content->size();
+    }
+    return File(impl);
+  }
+
+  bool FS::exists(const char* path) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    return files().count(path) != 0;
+  }
+
+  bool FS::remove(const char* path) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    return files().erase(path) != 0;
+  }
+
+  bool FS::rename(const char* pathFrom, const char* pathTo) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    std::map<std::string, std::shared_ptr<FileContent>>& all = files();
+    std::map<std::string, std::shared_ptr<FileContent>>::iterator it = all.find(pathFrom);
+    if (it == all.end()) return false;
+    std::shared_ptr<FileContent> content = it->second;
+    all.erase(it);
+    all[pathTo] = content;
+    return true;
+  }
+
+  // -------------------- LittleFS -------------------
+
+  size_t LittleFSFS::totalBytes() {
+    return 0x50000;
+  }
+
+  size_t LittleFSFS::usedBytes() {
+    std::lock_guard<std::mutex> guard(fsLock);
+    size_t used = 0;
+    for (const std::pair<const std::string, std::shared_ptr<FileContent>>& file : files()) used += file.second->size();
+    return used;
+  }
+
+}
@@ -0,0 +1,58 @@
+#include <driver/pcnt.h>
+
+#include <mutex>
+
+namespace {
+  std::mutex pcntLock;
+  int16_t counters[PCNT_UNIT_MAX] = { 0 };
+  int16_t highLimits[PCNT_UNIT_MAX] = { 0 };
+  bool paused[PCNT_UNIT_MAX] = { false };
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* pcnt_config) {
+  if (!pcnt_config || pcnt_config->unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> guard(pcntLock);
+  highLimits[pcnt_config->unit] = pcnt_config->counter_h_lim;
+  counters[pcnt_config->unit] = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t pcnt_unit, int16_t* count) {
+  if (pcnt_unit >= PCNT_UNIT_MAX || !count) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> guard(pcntLock);
+  *count = counters[pcnt_unit];
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t pcnt_unit) {
+  if (pcnt_unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> guard(pcntLock);
+  paused[pcnt_unit] = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t pcnt_unit) {
+  if (pcnt_unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> guard(pcntLock);
+  paused[pcnt_unit] = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t pcnt_unit) {
+  if (pcnt_unit >= PCNT_UNIT_MAX) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> guard(pcntLock);
+  counters[pcnt_unit] = 0;
+  return ESP_OK;
+}
+
+namespace native {
+  void pcntAddPulses(pcnt_unit_t pcnt_unit, int16_t pulses) {
+    if (pcnt_unit >= PCNT_UNIT_MAX) return;
+    std::lock_guard<std::mutex> guard(pcntLock);
+    if (paused[pcnt_unit]) return;
+    int32_t value = counters[pcnt_unit] + pulses;
+    // the hardware counter resets once the high limit is reached
+    if (highLimits[pcnt_unit] > 0 && value >= highLimits[pcnt_unit]) value = 0;
+    counters[pcnt_unit] = (int16_t)value;
+  }
+}
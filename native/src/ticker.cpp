@@ -0,0 +1,42 @@
+#include <Ticker.h>
+
+#include <chrono>
+
+Ticker::Ticker() : running(false), stopRequested(false) {}
+
+Ticker::~Ticker() {
+  detach();
+}
+
+void Ticker::_attach_ms(uint32_t milliseconds, bool repeat, callback_with_arg_t callback, void* arg, bool hasArg) {
+  detach();
+  stopRequested = false;
+  running = true;
+  worker = std::thread([this, milliseconds, repeat, callback, arg, hasArg]() {
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> guard(lock);
+    do {
+      next += std::chrono::milliseconds(milliseconds);
+      if (stopped.wait_until(guard, next, [this] { return stopRequested; })) break;
+      guard.unlock();
+      if (hasArg) callback(arg);
+      else reinterpret_cast<callback_t>(callback)();
+      guard.lock();
+    } while (repeat && !stopRequested);
+    running = false;
+  });
+}
+
+void Ticker::detach() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopRequested = true;
+  }
+  stopped.notify_all();
+  if (worker.joinable()) {
+    // a callback detaching its own ticker must not join itself
+    if (worker.get_id() == std::this_thread::get_id()) worker.detach();
+    else worker.join();
+  }
+  running = false;
+}
@@ -0,0 +1,159 @@
+#include <WiFi.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+
+WiFiClass WiFi;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+// -------------------- IPAddress -------------------
+
+bool IPAddress::fromString(const char* text) {
+  struct in_addr addr;
+  if (inet_pton(AF_INET, text, &addr) != 1) return false;
+  address.dword = addr.s_addr;
+  return true;
+}
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", address.bytes[0], address.bytes[1], address.bytes[2], address.bytes[3]);
+  return String(buf);
+}
+
+// -------------------- WiFi -------------------
+
+int WiFiClass::hostByName(const char* host, IPAddress& ip) {
+  if (ip.fromString(host)) return 1;
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result;
+  if (getaddrinfo(host, NULL, &hints, &result) != 0) return 0;
+  ip = IPAddress((uint32_t)((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(result);
+  return 1;
+}
+
+// -------------------- WiFiClient -------------------
+
+WiFiClient::WiFiClient() {
+  this->socket = -1;
+  this->peeked = -1;
+}
+
+WiFiClient::~WiFiClient() {
+  stop();
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  stop();
+  if (!WiFi.isConnected()) return 0;
+  this->socket = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (this->socket < 0) return 0;
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  if (::connect(this->socket, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    stop();
+    return 0;
+  }
+  int one = 1;
+  setsockopt(this->socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(this->socket, F_SETFL, fcntl(this->socket, F_GETFL, 0) | O_NONBLOCK);
+  return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) return 0;
+  return connect(ip, port);
+}
+
+size_t WiFiClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (this->socket < 0) return 0;
+  size_t sent = 0;
+  uint32_t start = millis();
+  while (sent < size) {
+    ssize_t n = send(this->socket, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && millis() - start < this->timeout) {
+      struct pollfd fd = { this->socket, POLLOUT, 0 };
+      poll(&fd, 1, 10);
+    } else {
+      stop();
+      break;
+    }
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  if (this->socket < 0) return 0;
+  int count = 0;
+  if (ioctl(this->socket, FIONREAD, &count) < 0) count = 0;
+  if (count == 0) {
+    // a closed connection reads as 0 bytes without blocking
+    uint8_t b;
+    ssize_t n = recv(this->socket, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) stop();
+  }
+  return count + (this->peeked >= 0 ? 1 : 0);
+}
+
+int WiFiClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+  size_t count = 0;
+  if (this->peeked >= 0) {
+    buf[count++] = (uint8_t)this->peeked;
+    this->peeked = -1;
+  }
+  if (this->socket < 0 || count == size) return count > 0 ? count : -1;
+  ssize_t n = recv(this->socket, buf + count, size - count, MSG_DONTWAIT);
+  if (n > 0) {
+    count += n;
+  } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+    stop();
+  }
+  return count > 0 ? count : -1;
+}
+
+int WiFiClient::peek() {
+  if (this->peeked < 0) this->peeked = read();
+  return this->peeked;
+}
+
+void WiFiClient::stop() {
+  // like closing an lwIP socket, wakes up a select() on it in another thread
+  if (this->socket >= 0) shutdown(this->socket, SHUT_RDWR);
+  if (this->socket >= 0) close(this->socket);
+  this->socket = -1;
+}
+
+uint8_t WiFiClient::connected() {
+  if (this->socket >= 0) available();
+  return this->socket >= 0 || this->peeked >= 0;
+}
@@ -0,0 +1,110 @@
+#include <Wire.h>
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+TwoWire::TwoWire(uint8_t busNum) :
+  num(busNum), frequency(100000), clockChanges(0), timeOut(50), txAddress(0), txLength(0), rxIndex(0), rxLength(0) {
+  memset(devices, 0, sizeof(devices));
+}
+
+TwoWire::~TwoWire() {}
+
+bool TwoWire::begin(int sda, int scl, uint32_t _frequency) {
+  if (_frequency != 0) frequency = _frequency;
+  return true;
+}
+
+bool TwoWire::end() {
+  return true;
+}
+
+bool TwoWire::setClock(uint32_t _frequency) {
+  if (frequency != _frequency) clockChanges++;
+  frequency = _frequency;
+  return true;
+}
+
+uint32_t TwoWire::getClock() {
+  return frequency;
+}
+
+void TwoWire::beginTransmission(uint16_t address) {
+  txAddress = address;
+  txLength = 0;
+}
+
+// Same return codes as the ESP32 core: 0 success, 2 NACK on address, 4 other error
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  NativeI2cDevice* device = txAddress < 128 ? devices[txAddress] : nullptr;
+  size_t length = txLength;
+  txLength = 0;
+  if (!device) return 2;
+  return device->onWrite(txBuffer, length) ? 0 : 4;
+}
+
+size_t TwoWire::requestFrom(uint16_t address, size_t size, bool sendStop) {
+  rxIndex = 0;
+  rxLength = 0;
+  NativeI2cDevice* device = address < 128 ? devices[address] : nullptr;
+  if (!device) return 0;
+  rxLength = device->onRead(rxBuffer, min(size, (size_t)I2C_BUFFER_LENGTH));
+  return rxLength;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (txLength >= I2C_BUFFER_LENGTH) return 0;
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+  for (size_t i = 0; i < quantity; i++) {
+    if (!write(data[i])) return i;
+  }
+  return quantity;
+}
+
+int TwoWire::available(void) {
+  return (int)(rxLength - rxIndex);
+}
+
+int TwoWire::read(void) {
+  if (rxIndex >= rxLength) return -1;
+  return rxBuffer[rxIndex++];
+}
+
+int TwoWire::peek(void) {
+  if (rxIndex >= rxLength) return -1;
+  return rxBuffer[rxIndex];
+}
+
+void TwoWire::flush(void) {
+  rxIndex = 0;
+  rxLength = 0;
+  txLength = 0;
+}
+
+void TwoWire::attachDevice(uint8_t address, NativeI2cDevice* device) {
+  if (address < 128) devices[address] = device;
+}
+
+void TwoWire::detachDevice(uint8_t address) {
+  if (address < 128) devices[address] = nullptr;
+}
+
+NativeI2cDevice* TwoWire::getDevice(uint8_t address) {
+  return address < 128 ? devices[address] : nullptr;
+}
+
+bool NativeI2cLoopback::onWrite(const uint8_t* data, size_t length) {
+  lastLength = min(length, sizeof(last));
+  memcpy(last, data, lastLength);
+  return true;
+}
+
+size_t NativeI2cLoopback::onRead(uint8_t* data, size_t length) {
+  length = min(length, lastLength);
+  memcpy(data, last, length);
+  return length;
+}
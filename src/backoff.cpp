@@ -0,0 +1,23 @@
+#include <backoff.h>
+
+Backoff::Backoff(uint32_t minMs, uint32_t maxMs) {
+  this->minMs = minMs;
+  this->maxMs = maxMs;
+  this->failures = 0;
+}
+
+uint32_t Backoff::nextDelay(uint32_t random) {
+  uint32_t ceiling = this->minMs;
+  for (uint16_t i = 0; i < this->failures && ceiling < this->maxMs; i++) ceiling *= 2;
+  if (ceiling > this->maxMs) ceiling = this->maxMs;
+  if (this->failures < UINT16_MAX) this->failures++;
+  return (uint32_t)(((uint64_t)random * ((uint64_t)ceiling + 1)) >> 32);
+}
+
+void Backoff::reset() {
+  this->failures = 0;
+}
+
+uint16_t Backoff::getFailures() {
+  return this->failures;
+}
@@ -13,6 +13,7 @@ Buzzer::Buzzer(Model* _model, uint8_t _buzzerPin) {
   this->model = _model;
   this->buzzerPin = _buzzerPin;
   cyclicTimer = new Ticker();
+  beepTicker = new Ticker();
 
   // https://arduino.stackexchange.com/questions/81123/using-lambdas-as-callback-functions
   //  cyclicTimer->attach<typeof this>(1, [](typeof this p) { p->timer(); },
@@ -47,6 +48,7 @@ Buzzer::Buzzer(Model* _model, uint8_t _buzzerPin) {
 
 Buzzer::~Buzzer() {
   if (this->cyclicTimer) delete cyclicTimer;
+  if (this->beepTicker) delete beepTicker;
 }
 
 void Buzzer::alert() {
@@ -54,13 +56,20 @@ void Buzzer::alert() {
 }
 
 void Buzzer::beep(uint8_t n) {
-  if (config.buzzerMode == BUZ_OFF) return;
-  for (uint8_t i = 0; i < n;i++) {
-    ledcWrite(PWM_CHANNEL_BUZZER, BUZZER_DUTY);
-    delay(50);
-    ledcWrite(PWM_CHANNEL_BUZZER, 0);
-    delay(50);
+  if (config.buzzerMode == BUZ_OFF || n == 0) return;
+  beepTicker->detach();
+  this->beepSteps = 2 * n;
+  beepStep();
+  beepTicker->attach_ms(50, +[](Buzzer* instance) { instance->beepStep(); }, this);
+}
+
+void Buzzer::beepStep() {
+  if (this->beepSteps == 0) {
+    beepTicker->detach();
+    return;
   }
+  this->beepSteps--;
+  ledcWrite(PWM_CHANNEL_BUZZER, this->beepSteps % 2 == 1 ? BUZZER_DUTY : 0);
 }
 
 void Buzzer::update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus) {
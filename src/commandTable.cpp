@@ -0,0 +1,82 @@
+#include <commandTable.h>
+#include <config.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+namespace CommandTable {
+
+  const Command* find(const Command* commands, size_t count, const char* name) {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      int result = strcmp(name, commands[mid].name);
+      if (result == 0) return &commands[mid];
+      if (result < 0) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+    return NULL;
+  }
+
+  boolean parse(const Command* command, const char* payload, unsigned int length, CommandArgument& argument) {
+    argument.number = 0;
+    argument.payload = payload;
+    argument.length = length;
+    argument.id = NULL;
+    if (command->argType == CA_NONE || command->argType == CA_PAYLOAD || command->argType == CA_RAW) return true;
+    char* end;
+    errno = 0;
+    switch (command->argType) {
+      case CA_INT:
+        argument.number = strtol(payload, &end, 10);
+        break;
+      case CA_UINT:
+        // strtoul silently negates "-1"
+        if (strchr(payload, '-')) return false;
+        argument.number = strtoul(payload, &end, 10);
+        break;
+      default:
+        argument.number = strtof(payload, &end);
+        // "nan" would pass any range check, "inf" isn't a setting either
+        if (!isfinite(argument.number)) return false;
+        break;
+    }
+    if (end == payload || errno != 0) return false;
+    while (isspace((unsigned char)*end)) end++;
+    return *end == 0x00;
+  }
+
+  CommandResult execute(const Command* command, const char* payload, unsigned int length, const char* id) {
+    CommandArgument argument;
+    if (!parse(command, payload, length, argument)) return CR_INVALID;
+    argument.id = id;
+    if ((command->argType == CA_INT || command->argType == CA_UINT || command->argType == CA_FLOAT)
+      && (argument.number < command->min || argument.number > command->max)) return CR_OUT_OF_RANGE;
+    return command->handler(argument);
+  }
+
+  CommandResult dispatch(const Command* commands, size_t count, const char* name, const char* payload, unsigned int length, const char* id) {
+    const Command* command = find(commands, count, name);
+    if (!command) return CR_UNKNOWN;
+    return execute(command, payload, length, id);
+  }
+
+  const char* resultToString(CommandResult result) {
+    switch (result) {
+      case CR_OK: return "ok";
+      case CR_UNKNOWN: return "unknown command";
+      case CR_INVALID: return "invalid argument";
+      case CR_OUT_OF_RANGE: return "argument out of range";
+      case CR_TOO_LONG: return "payload too long";
+      case CR_QUEUED: return "queued";
+      case CR_BUSY: return "busy";
+      case CR_FAILED: return "failed";
+      default: return "?";
+    }
+  }
+
+}
@@ -0,0 +1,61 @@
+#include <commandWorker.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+namespace CommandWorker {
+
+  struct CommandJob {
+    const Command* command;
+    char id[COMMAND_ID_LEN + 1];
+    char* payload;
+    unsigned int length;
+  };
+
+  TaskHandle_t commandWorkerTask;
+  QueueHandle_t commandQueue;
+  commandResultCallback_t resultCallback;
+
+  void commandWorkerLoop(void* pvParameters) {
+    CommandJob job;
+    while (1) {
+      if (xQueueReceive(commandQueue, &job, portMAX_DELAY) != pdTRUE) continue;
+      ESP_LOGD(TAG, "Running command [%s] (%s)", job.command->name, job.id);
+      CommandResult result = CommandTable::execute(job.command, job.payload ? job.payload : "", job.length, job.id);
+      free(job.payload);
+      // handed on again, whoever completes it reports the result
+      if (result != CR_QUEUED) resultCallback(job.command->name, job.id, result);
+    }
+  }
+
+  boolean setup(commandResultCallback_t _resultCallback, uint32_t stackSize, UBaseType_t priority, BaseType_t core) {
+    resultCallback = _resultCallback;
+    commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(CommandJob));
+    if (commandQueue == NULL) {
+      ESP_LOGE(TAG, "Queue creation failed!");
+      return false;
+    }
+    if (xTaskCreatePinnedToCore(commandWorkerLoop, "commandWorker", stackSize, NULL, priority, &commandWorkerTask, core) != pdPASS) {
+      ESP_LOGE(TAG, "Task creation failed!");
+      vQueueDelete(commandQueue);
+      commandQueue = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  boolean submit(const Command* command, const char* id, char* payload, unsigned int length) {
+    CommandJob job;
+    job.command = command;
+    strncpy(job.id, id, COMMAND_ID_LEN);
+    job.id[COMMAND_ID_LEN] = 0x00;
+    job.payload = payload;
+    job.length = length;
+    if (!commandQueue || xQueueSendToBack(commandQueue, &job, 0) != pdTRUE) {
+      free(payload);
+      return false;
+    }
+    return true;
+  }
+
+}
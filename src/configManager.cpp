@@ -26,6 +26,16 @@ Config config;
   "mqttMirrorDevice" false,
   "mqttMirrordeviceId": 65535,
   "mqttMirrorTopic": "123456789112345678921",
+  "mqttMsgPack": false,
+  "mqttReconnectMin": 65535,
+  "mqttReconnectMax": 65535,
+  "deadbandCo2": 65535,
+  "deadbandTemperature": 255,
+  "deadbandHumidity": 255,
+  "deadbandPm": 65535,
+  "sensorsHeartbeat": 65535,
+  "sensorsBatchSize": 10,
+  "sensorsBatchInterval": 65535,
   "altitude": 12345,
   "co2GreenThreshold": 0,
   "co2YellowThreshold": 800,
@@ -55,6 +65,16 @@ Config config;
 #define DEFAULT_MQTT_MIRROR                    false
 #define DEFAULT_MQTT_MIRROR_DEVICE_ID              0
 #define DEFAULT_MQTT_MIRROR_TOPIC       "co2monitor"
+#define DEFAULT_MQTT_MSGPACK                   false
+#define DEFAULT_MQTT_RECONNECT_MIN                 1
+#define DEFAULT_MQTT_RECONNECT_MAX               120
+#define DEFAULT_DEADBAND_CO2                      10
+#define DEFAULT_DEADBAND_TEMPERATURE               2
+#define DEFAULT_DEADBAND_HUMIDITY                 10
+#define DEFAULT_DEADBAND_PM                        5
+#define DEFAULT_SENSORS_HEARTBEAT                300
+#define DEFAULT_SENSORS_BATCH_SIZE                 1
+#define DEFAULT_SENSORS_BATCH_INTERVAL            60
 #define DEFAULT_ALTITUDE                           5
 #define DEFAULT_CO2_GREEN_THRESHOLD              420
 #define DEFAULT_CO2_YELLOW_THRESHOLD             700
@@ -99,6 +119,16 @@ void setupConfigManager() {
   configParameterVector.push_back(new BooleanConfigParameter<Config>("mqttMirror", "Mirror other device's measurements", &Config::mqttMirrorDevice, DEFAULT_MQTT_MIRROR, true));
   configParameterVector.push_back(new Uint16ConfigParameter<Config>("mqttMirrordeviceId", "Id of device to mirror", &Config::mqttMirrordeviceId, DEFAULT_MQTT_MIRROR_DEVICE_ID, true));
   configParameterVector.push_back(new CharArrayConfigParameter<Config>("mqttMirrorTopic", "MQTT topic of device to mirror", (char Config::*) & Config::mqttMirrorTopic, DEFAULT_MQTT_MIRROR_TOPIC, MQTT_TOPIC_LEN, true));
+  configParameterVector.push_back(new BooleanConfigParameter<Config>("mqttMsgPack", "Publish readings as MessagePack", &Config::mqttMsgPack, DEFAULT_MQTT_MSGPACK));
+  configParameterVector.push_back(new Uint16ConfigParameter<Config>("mqttReconnectMin", "MQTT reconnect min. backoff (s)", &Config::mqttReconnectMin, DEFAULT_MQTT_RECONNECT_MIN, 1, 3600));
+  configParameterVector.push_back(new Uint16ConfigParameter<Config>("mqttReconnectMax", "MQTT reconnect max. backoff (s)", &Config::mqttReconnectMax, DEFAULT_MQTT_RECONNECT_MAX, 1, 65535));
+  configParameterVector.push_back(new Uint16ConfigParameter<Config>("deadbandCo2", "CO2 publish deadband (ppm)", &Config::deadbandCo2, DEFAULT_DEADBAND_CO2));
+  configParameterVector.push_back(new Uint8ConfigParameter<Config>("deadbandTemperature", "Temperature publish deadband (0.1C)", &Config::deadbandTemperature, DEFAULT_DEADBAND_TEMPERATURE));
+  configParameterVector.push_back(new Uint8ConfigParameter<Config>("deadbandHumidity", "Humidity publish deadband (0.1%)", &Config::deadbandHumidity, DEFAULT_DEADBAND_HUMIDITY));
+  configParameterVector.push_back(new Uint16ConfigParameter<Config>("deadbandPm", "PM publish deadband (#/cm3)", &Config::deadbandPm, DEFAULT_DEADBAND_PM));
+  configParameterVector.push_back(new Uint16ConfigParameter<Config>("sensorsHeartbeat", "Max. time between publishes (s)", &Config::sensorsHeartbeat, DEFAULT_SENSORS_HEARTBEAT));
+  configParameterVector.push_back(new Uint8ConfigParameter<Config>("sensorsBatchSize", "Readings per MQTT message", &Config::sensorsBatchSize, DEFAULT_SENSORS_BATCH_SIZE, 1, SENSORS_BATCH_MAX));
+  configParameterVector.push_back(new Uint16ConfigParameter<Config>("sensorsBatchInterval", "Max. age of batched readings (s)", &Config::sensorsBatchInterval, DEFAULT_SENSORS_BATCH_INTERVAL));
   configParameterVector.push_back(new Uint16ConfigParameter<Config>("altitude", "Altitude", &Config::altitude, DEFAULT_ALTITUDE, 0, 8000));
   configParameterVector.push_back(new Uint16ConfigParameter<Config>("co2GreenThreshold", "CO2 Green threshold ", &Config::co2GreenThreshold, DEFAULT_CO2_GREEN_THRESHOLD));
   configParameterVector.push_back(new Uint16ConfigParameter<Config>("co2YellowThreshold", "CO2 Yellow threshold ", &Config::co2YellowThreshold, DEFAULT_CO2_YELLOW_THRESHOLD));
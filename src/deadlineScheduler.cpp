@@ -0,0 +1,123 @@
+#include <deadlineScheduler.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+DeadlineScheduler::DeadlineScheduler(randomSource_t random) {
+  this->random = random;
+  this->heapSize = 0;
+  for (uint8_t i = 0; i < DEADLINE_SCHEDULER_JOBS; i++) this->jobs[i].active = false;
+}
+
+int8_t DeadlineScheduler::add(const char* name, deadlineJob_t job, void* arg, uint32_t periodMs, uint32_t phaseMs, uint32_t jitterMs, uint32_t now) {
+  for (int8_t id = 0; id < DEADLINE_SCHEDULER_JOBS; id++) {
+    if (this->jobs[id].active) continue;
+    Job& j = this->jobs[id];
+    j.name = name;
+    j.run = job;
+    j.arg = arg;
+    j.periodMs = periodMs;
+    j.jitterMs = jitterMs;
+    j.runs = 0;
+    j.missed = 0;
+    j.active = true;
+    schedule(j, now + phaseMs);
+    this->heap[this->heapSize] = id;
+    siftUp(this->heapSize++);
+    return id;
+  }
+  ESP_LOGE(TAG, "No room for job %s", name);
+  return -1;
+}
+
+void DeadlineScheduler::schedule(Job& job, uint32_t base) {
+  job.base = base;
+  job.due = base + (job.jitterMs > 0 ? this->random() % (job.jitterMs + 1) : 0);
+}
+
+void DeadlineScheduler::ranAt(int8_t id, uint32_t now) {
+  if (id < 0 || !this->jobs[id].active) return;
+  schedule(this->jobs[id], now + this->jobs[id].periodMs);
+  fix(id);
+}
+
+uint32_t DeadlineScheduler::runDue(uint32_t now) {
+  while (this->heapSize > 0 && (int32_t)(now - this->jobs[this->heap[0]].due) >= 0) {
+    int8_t id = this->heap[0];
+    Job& job = this->jobs[id];
+    uint32_t period = job.run(job.arg);
+    job.runs++;
+    if (period == 0) {
+      job.active = false;
+      this->heap[0] = this->heap[--this->heapSize];
+      siftDown(0);
+      continue;
+    }
+    job.periodMs = period;
+    uint32_t base = job.base + period;
+    int32_t late = (int32_t)(now - base);
+    if (late >= 0) {
+      // a whole period or more behind, skip to the next deadline still ahead
+      uint32_t skipped = late / period + 1;
+      job.missed += skipped;
+      base += skipped * period;
+    }
+    schedule(job, base);
+    siftDown(0);
+  }
+  return msUntilNext(now);
+}
+
+uint32_t DeadlineScheduler::msUntilNext(uint32_t now) {
+  if (this->heapSize == 0) return UINT32_MAX;
+  int32_t remaining = (int32_t)(this->jobs[this->heap[0]].due - now);
+  return remaining > 0 ? remaining : 0;
+}
+
+uint32_t DeadlineScheduler::getRuns(int8_t id) {
+  return id < 0 ? 0 : this->jobs[id].runs;
+}
+
+uint32_t DeadlineScheduler::getMissed(int8_t id) {
+  return id < 0 ? 0 : this->jobs[id].missed;
+}
+
+uint32_t DeadlineScheduler::getNextDeadline(int8_t id) {
+  return id < 0 ? 0 : this->jobs[id].base;
+}
+
+boolean DeadlineScheduler::before(int8_t a, int8_t b) {
+  return (int32_t)(this->jobs[a].due - this->jobs[b].due) < 0;
+}
+
+void DeadlineScheduler::siftUp(uint8_t index) {
+  while (index > 0) {
+    uint8_t parent = (index - 1) / 2;
+    if (!before(this->heap[index], this->heap[parent])) return;
+    std::swap(this->heap[index], this->heap[parent]);
+    index = parent;
+  }
+}
+
+void DeadlineScheduler::siftDown(uint8_t index) {
+  while (true) {
+    uint8_t smallest = index;
+    uint8_t left = 2 * index + 1;
+    uint8_t right = left + 1;
+    if (left < this->heapSize && before(this->heap[left], this->heap[smallest])) smallest = left;
+    if (right < this->heapSize && before(this->heap[right], this->heap[smallest])) smallest = right;
+    if (smallest == index) return;
+    std::swap(this->heap[index], this->heap[smallest]);
+    index = smallest;
+  }
+}
+
+void DeadlineScheduler::fix(int8_t id) {
+  for (uint8_t i = 0; i < this->heapSize; i++) {
+    if (this->heap[i] == id) {
+      siftUp(i);
+      siftDown(i);
+      return;
+    }
+  }
+}
@@ -0,0 +1,131 @@
+#include <eventBus.h>
+#include <config.h>
+#include <esp_timer.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+namespace EventBus {
+
+  struct ModelEvent {
+    uint16_t mask;
+    TrafficLightStatus oldStatus;
+    TrafficLightStatus newStatus;
+    int64_t published;
+    ModelSnapshot data;
+  };
+
+  struct Subscriber {
+    const char* name;
+    uint16_t mask;
+    modelEventHandler_t handler;
+    EventBusStats stats;
+  };
+
+  TaskHandle_t dispatcherTask;
+  QueueHandle_t eventQueue;
+  Subscriber subscribers[EVENT_BUS_MAX_SUBSCRIBERS];
+  volatile uint8_t subscriberCount = 0;
+  // union of all subscriber masks, events nobody is interested in aren't queued
+  volatile uint16_t subscribedMask = 0;
+  uint32_t dropped = 0;
+  portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+  void dispatchLoop(void* pvParameters) {
+    ModelEvent event;
+    while (1) {
+      if (xQueueReceive(eventQueue, &event, portMAX_DELAY) != pdTRUE) continue;
+      uint8_t count = subscriberCount;
+      for (uint8_t i = 0; i < count; i++) {
+        Subscriber* subscriber = &subscribers[i];
+        if ((event.mask & subscriber->mask) == 0) continue;
+        uint32_t latency = (uint32_t)(esp_timer_get_time() - event.published);
+        portENTER_CRITICAL(&statsMux);
+        subscriber->stats.handled++;
+        subscriber->stats.lastLatencyUs = latency;
+        if (latency > subscriber->stats.maxLatencyUs) subscriber->stats.maxLatencyUs = latency;
+        subscriber->stats.totalLatencyUs += latency;
+        portEXIT_CRITICAL(&statsMux);
+        subscriber->handler(event.mask, event.oldStatus, event.newStatus, event.data);
+      }
+    }
+  }
+
+  boolean setup(uint32_t stackSize, UBaseType_t priority, BaseType_t core) {
+    eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(ModelEvent));
+    if (eventQueue == NULL) {
+      ESP_LOGE(TAG, "Queue creation failed!");
+      return false;
+    }
+    if (xTaskCreatePinnedToCore(dispatchLoop, "eventBus", stackSize, NULL, priority, &dispatcherTask, core) != pdPASS) {
+      ESP_LOGE(TAG, "Task creation failed!");
+      vQueueDelete(eventQueue);
+      eventQueue = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  boolean subscribe(const char* name, uint16_t mask, modelEventHandler_t handler) {
+    if (subscriberCount >= EVENT_BUS_MAX_SUBSCRIBERS) {
+      ESP_LOGE(TAG, "Too many subscribers, can't add %s", name);
+      return false;
+    }
+    Subscriber* subscriber = &subscribers[subscriberCount];
+    subscriber->name = name;
+    subscriber->mask = mask;
+    subscriber->handler = handler;
+    subscriber->stats = { 0, 0, 0, 0 };
+    // the dispatcher only looks at fully set up subscribers
+    subscriberCount++;
+    subscribedMask |= mask;
+    return true;
+  }
+
+  void publish(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {
+    if (!eventQueue || (mask & subscribedMask) == 0) return;
+    ModelEvent event = { mask, oldStatus, newStatus, esp_timer_get_time(), data };
+    if (xQueueSendToBack(eventQueue, &event, 0) != pdTRUE) {
+      portENTER_CRITICAL(&statsMux);
+      dropped++;
+      portEXIT_CRITICAL(&statsMux);
+    }
+  }
+
+  uint8_t getSubscriberCount() {
+    return subscriberCount;
+  }
+
+  const char* getSubscriberName(uint8_t index) {
+    if (index >= subscriberCount) return NULL;
+    return subscribers[index].name;
+  }
+
+  EventBusStats getStats(uint8_t index) {
+    EventBusStats stats = { 0, 0, 0, 0 };
+    if (index >= subscriberCount) return stats;
+    portENTER_CRITICAL(&statsMux);
+    stats = subscribers[index].stats;
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+  }
+
+  uint32_t getDropped() {
+    portENTER_CRITICAL(&statsMux);
+    uint32_t result = dropped;
+    portEXIT_CRITICAL(&statsMux);
+    return result;
+  }
+
+  void logStats() {
+    if (!dispatcherTask) return;
+    ESP_LOGI(TAG, "EventBus dropped %u | %u bytes left", getDropped(), uxTaskGetStackHighWaterMark(dispatcherTask));
+    for (uint8_t i = 0; i < subscriberCount; i++) {
+      EventBusStats stats = getStats(i);
+      ESP_LOGI(TAG, "%s: handled %u, latency last %uus, avg %uus, max %uus",
+        subscribers[i].name, stats.handled, stats.lastLatencyUs,
+        stats.handled ? (uint32_t)(stats.totalLatencyUs / stats.handled) : 0, stats.maxLatencyUs);
+    }
+  }
+
+}
@@ -103,9 +103,9 @@ uint8_t Fan::getFanPwm(void) {
   return duty;
 }
 
-void Fan::update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus) {
+void Fan::update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {
   if (!(mask & (M_CO2 | M_CONFIG_CHANGED))) return;
-  uint16_t ppm = model->getCo2();
+  uint16_t ppm = data.co2;
   if (ppm <= config.co2GreenThreshold) {
     setFanPwm(config.minPwm);
   } else if (ppm < config.co2YellowThreshold) {
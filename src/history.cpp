@@ -0,0 +1,125 @@
+#include <history.h>
+#include <config.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+template <typename T, uint16_t N, uint8_t M>
+History<T, N, M>::History() {
+  clear();
+}
+
+template <typename T, uint16_t N, uint8_t M>
+void History<T, N, M>::clear() {
+  this->count = 0;
+  for (uint8_t w = 0; w < HW_COUNT; w++) {
+    this->windowStart[w] = 0;
+    for (uint8_t m = 0; m < M; m++) {
+      this->sums[w][m] = 0;
+      this->minCursor[w][m] = 0;
+      this->maxCursor[w][m] = 0;
+    }
+  }
+  for (uint8_t m = 0; m < M; m++) {
+    this->minDeque[m].front = this->minDeque[m].back = 0;
+    this->maxDeque[m].front = this->maxDeque[m].back = 0;
+  }
+}
+
+template <typename T, uint16_t N, uint8_t M>
+uint16_t History<T, N, M>::size() {
+  return (uint16_t)min(this->count, (uint32_t)N);
+}
+
+// sequence number of the sample currently stored in the given slot
+template <typename T, uint16_t N, uint8_t M>
+uint32_t History<T, N, M>::sequenceOf(uint16_t slot) {
+  uint32_t last = this->count - 1;
+  return last - ((last % N + N - slot) % N);
+}
+
+template <typename T, uint16_t N, uint8_t M>
+void History<T, N, M>::push(Deque& deque, uint32_t cursors[HW_COUNT][M], uint8_t metric, uint16_t slot, bool isMin) {
+  T value = this->values[metric][slot];
+  while (deque.back != deque.front) {
+    T last = this->values[metric][deque.slot[(deque.back - 1) % N]];
+    if (isMin ? (last < value) : (last > value)) break;
+    deque.back--;
+  }
+  uint32_t position = deque.back;
+  deque.slot[position % N] = slot;
+  deque.back++;
+  // the new sample is part of every window, so it's the extreme of any window whose extreme was just dropped
+  for (uint8_t w = 0; w < HW_COUNT; w++) {
+    if (cursors[w][metric] > position) cursors[w][metric] = position;
+  }
+}
+
+template <typename T, uint16_t N, uint8_t M>
+void History<T, N, M>::evictOldest(uint8_t window) {
+  uint16_t slot = this->windowStart[window] % N;
+  this->windowStart[window]++;
+  for (uint8_t m = 0; m < M; m++) {
+    this->sums[window][m] -= this->values[m][slot];
+    Deque& minQ = this->minDeque[m];
+    Deque& maxQ = this->maxDeque[m];
+    while (this->minCursor[window][m] < minQ.back && sequenceOf(minQ.slot[this->minCursor[window][m] % N]) < this->windowStart[window])
+      this->minCursor[window][m]++;
+    while (this->maxCursor[window][m] < maxQ.back && sequenceOf(maxQ.slot[this->maxCursor[window][m] % N]) < this->windowStart[window])
+      this->maxCursor[window][m]++;
+    if (window == HW_COUNT - 1) {
+      // the deques only need to cover the longest window
+      minQ.front = this->minCursor[window][m];
+      maxQ.front = this->maxCursor[window][m];
+    }
+  }
+}
+
+template <typename T, uint16_t N, uint8_t M>
+void History<T, N, M>::expire(uint32_t now) {
+  for (uint8_t w = 0; w < HW_COUNT; w++) {
+    while (this->windowStart[w] < this->count && (now - this->timestamps[this->windowStart[w] % N]) >= HISTORY_WINDOW_MS[w]) {
+      evictOldest(w);
+    }
+  }
+}
+
+template <typename T, uint16_t N, uint8_t M>
+void History<T, N, M>::append(uint32_t timestamp, const T sample[M]) {
+  uint16_t slot = this->count % N;
+  if (this->count >= N) {
+    // slot is about to be overwritten, drop it from any window still referencing it
+    for (uint8_t w = 0; w < HW_COUNT; w++) {
+      if (this->windowStart[w] <= this->count - N) evictOldest(w);
+    }
+  }
+  this->timestamps[slot] = timestamp;
+  for (uint8_t m = 0; m < M; m++) {
+    this->values[m][slot] = sample[m];
+  }
+  this->count++;
+  for (uint8_t m = 0; m < M; m++) {
+    push(this->minDeque[m], this->minCursor, m, slot, true);
+    push(this->maxDeque[m], this->maxCursor, m, slot, false);
+    for (uint8_t w = 0; w < HW_COUNT; w++) {
+      this->sums[w][m] += sample[m];
+    }
+  }
+  expire(timestamp);
+}
+
+template <typename T, uint16_t N, uint8_t M>
+HistoryStats History<T, N, M>::getStats(uint8_t metric, HistoryWindow window, uint32_t now) {
+  HistoryStats stats = { NAN, NAN, NAN, 0 };
+  if (metric >= M || window >= HW_COUNT) return stats;
+  expire(now);
+  uint32_t samples = this->count - this->windowStart[window];
+  if (samples == 0) return stats;
+  stats.count = (uint16_t)samples;
+  stats.min = this->values[metric][this->minDeque[metric].slot[this->minCursor[window][metric] % N]];
+  stats.max = this->values[metric][this->maxDeque[metric].slot[this->maxCursor[window][metric] % N]];
+  stats.mean = (float)this->sums[window][metric] / samples;
+  return stats;
+}
+
+#include <history.tpp>
@@ -0,0 +1,5 @@
+// -------------------- template instantiations -------------------
+
+template class History<uint16_t, HISTORY_LENGTH, 1>;
+template class History<int16_t, HISTORY_LENGTH, 2>;
+template class History<uint16_t, HISTORY_PM_LENGTH, 5>;
@@ -2,6 +2,9 @@
 #include <mqtt.h>
 #include <ota.h>
 #include <wifiManager.h>
+#include <eventBus.h>
+#include <commandWorker.h>
+#include <i2c.h>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
@@ -13,8 +16,14 @@ namespace housekeeping {
     ESP_LOGI(TAG, "Heap: Free:%u, Min:%u, Size:%u, Alloc:%u, StackHWM:%u",
       ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getHeapSize(),
       ESP.getMaxAllocHeap(), uxTaskGetStackHighWaterMark(NULL));
-    ESP_LOGI(TAG, "MqttLoop %u bytes left | Taskstate = %d | core = %u",
-      uxTaskGetStackHighWaterMark(mqtt::mqttTask), eTaskGetState(mqtt::mqttTask), xTaskGetAffinity(mqtt::mqttTask));
+    ESP_LOGI(TAG, "MqttLoop %u bytes left | Taskstate = %d | core = %u | wakeups = %u",
+      uxTaskGetStackHighWaterMark(mqtt::mqttTask), eTaskGetState(mqtt::mqttTask), xTaskGetAffinity(mqtt::mqttTask), mqtt::getLoopWakeups());
+    mqtt::MqttQueueStats queueStats = mqtt::getQueueStats();
+    ESP_LOGI(TAG, "MqttQueue control dropped = %u | high water = %u | samples coalesced = %u | metrics coalesced = %u",
+      queueStats.controlDropped, queueStats.controlHighWater, queueStats.samplesCoalesced, queueStats.metricsCoalesced);
+    mqtt::MqttConnectionStats connectionStats = mqtt::getConnectionStats();
+    ESP_LOGI(TAG, "MqttConnection connects = %u | disconnects = %u | last reconnect = %u ms | publish failures = %u/%u",
+      connectionStats.connects, connectionStats.disconnects, connectionStats.lastReconnectMs, connectionStats.publishFailures, connectionStats.publishes);
     ESP_LOGI(TAG, "OtaLoop %u bytes left | Taskstate = %d | core = %u",
       uxTaskGetStackHighWaterMark(OTA::otaTask), eTaskGetState(OTA::otaTask), xTaskGetAffinity(OTA::otaTask));
     ESP_LOGI(TAG, "WifiLoop %u bytes left | Taskstate = %d | core = %u",
@@ -23,6 +32,16 @@ namespace housekeeping {
       ESP_LOGI(TAG, "SensorsLoop %u bytes left | Taskstate = %d | core = %u",
         uxTaskGetStackHighWaterMark(sensorsTask), eTaskGetState(sensorsTask), xTaskGetAffinity(sensorsTask));
     }
+    if (CommandWorker::commandWorkerTask) {
+      ESP_LOGI(TAG, "CommandWorker %u bytes left | Taskstate = %d | core = %u",
+        uxTaskGetStackHighWaterMark(CommandWorker::commandWorkerTask), eTaskGetState(CommandWorker::commandWorkerTask), xTaskGetAffinity(CommandWorker::commandWorkerTask));
+    }
+    if (I2C::i2cTask) {
+      ESP_LOGI(TAG, "I2CLoop %u bytes left | Taskstate = %d | core = %u",
+        uxTaskGetStackHighWaterMark(I2C::i2cTask), eTaskGetState(I2C::i2cTask), xTaskGetAffinity(I2C::i2cTask));
+      I2C::logStats();
+    }
+    EventBus::logStats();
     if (ESP.getMinFreeHeap() <= 2048) {
       ESP_LOGW(TAG,
         "Memory full, counter cleared (heap low water mark = %u Bytes / "
@@ -23,39 +23,146 @@ namespace I2C {
     return sps30Detected;
   }
 
-  static SemaphoreHandle_t i2cMutex = xSemaphoreCreateMutex();
+  TaskHandle_t i2cTask = NULL;
+  QueueHandle_t i2cQueue = NULL;
+  I2CBackend* backend = NULL;
 
-  boolean takeMutex(TickType_t blockTime) {
-    //  ESP_LOGD(TAG, "%s attempting to take mutex with blockTime: %u", pcTaskGetTaskName(NULL), blockTime);
-    if (i2cMutex == NULL) {
-      ESP_LOGD(TAG, "i2cMutex is NULL unsuccessful <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<");
+  // only touched by the bus task
+  uint32_t currentClock;
+  uint32_t clockChanges = 0;
+  DeviceStats deviceStats[I2C_MAX_DEVICES];
+  uint8_t devices = 0;
+
+  // a device gets an entry once it answered, the bus scan doesn't fill the table with empty addresses
+  DeviceStats* statsFor(uint8_t address, boolean create) {
+    for (uint8_t i = 0; i < devices; i++) {
+      if (deviceStats[i].address == address) return &deviceStats[i];
+    }
+    if (!create || devices >= I2C_MAX_DEVICES) return NULL;
+    DeviceStats* stats = &deviceStats[devices];
+    memset(stats, 0, sizeof(DeviceStats));
+    stats->address = address;
+    // published last so a reader never sees a half initialised entry
+    devices++;
+    return stats;
+  }
+
+  void execute(Transaction* transaction) {
+    uint32_t start = micros();
+    if (transaction->clock != currentClock) {
+      Wire.setClock(transaction->clock);
+      currentClock = transaction->clock;
+      clockChanges++;
+    }
+    transaction->success = transaction->run ? transaction->run(transaction->arg)
+      : backend->transfer(transaction->address, transaction->writeBuffer, transaction->writeLength, transaction->readBuffer, transaction->readLength, transaction->readDelayMs);
+    uint32_t duration = micros() - start;
+    DeviceStats* stats = statsFor(transaction->address, transaction->success);
+    if (stats) {
+      stats->transactions++;
+      if (!transaction->success) stats->failures++;
+      stats->busUs += duration;
+      stats->maxUs = max(stats->maxUs, duration);
+    }
+    // the caller may return and take the descriptor with it as soon as it sees this
+    if (transaction->caller != i2cTask) xTaskNotify(transaction->caller, X_CMD_I2C_DONE, eSetBits);
+  }
+
+  void i2cLoop(void* pvParameters) {
+    Transaction* batch[I2C_QUEUE_LENGTH];
+    while (1) {
+      if (xQueueReceive(i2cQueue, &batch[0], portMAX_DELAY) != pdTRUE) continue;
+      uint8_t pending = 1;
+      while (pending < I2C_QUEUE_LENGTH && xQueueReceive(i2cQueue, &batch[pending], 0) == pdTRUE) pending++;
+      // whatever runs at the current clock goes first, then one clock at a time, each in arrival order
+      uint8_t count = pending;
+      while (pending > 0) {
+        uint32_t clock = 0;
+        for (uint8_t i = 0; i < count; i++) {
+          if (!batch[i]) continue;
+          if (clock == 0 || batch[i]->clock == currentClock) clock = batch[i]->clock;
+          if (clock == currentClock) break;
+        }
+        for (uint8_t i = 0; i < count; i++) {
+          if (!batch[i] || batch[i]->clock != clock) continue;
+          execute(batch[i]);
+          batch[i] = NULL;
+          pending--;
+        }
+      }
+    }
+  }
+
+  boolean transact(Transaction& transaction, TickType_t blockTime) {
+    transaction.success = false;
+    transaction.caller = xTaskGetCurrentTaskHandle();
+    if (transaction.caller == i2cTask) {
+      // from within a callback, the bus is ours already
+      execute(&transaction);
+      return transaction.success;
+    }
+    Transaction* queued = &transaction;
+    if (!i2cQueue || xQueueSendToBack(i2cQueue, &queued, blockTime) != pdTRUE) {
+      ESP_LOGD(TAG, "%s could not queue transaction for %x", pcTaskGetTaskName(NULL), transaction.address);
       return false;
     }
-    boolean result = (xSemaphoreTake(i2cMutex, blockTime) == pdTRUE);
-    if (!result) ESP_LOGD(TAG, "%s take mutex was: %s", pcTaskGetTaskName(NULL), result ? "successful" : "unsuccessful <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<");
-    return result;
+    // other notifications arriving meanwhile are handed back to the task once done
+    uint32_t notified = 0;
+    uint32_t others = 0;
+    do {
+      xTaskNotifyWait(0x00, X_CMD_I2C_DONE, &notified, portMAX_DELAY);
+      others |= notified & ~X_CMD_I2C_DONE;
+    } while (!(notified & X_CMD_I2C_DONE));
+    if (others) xTaskNotify(transaction.caller, others, eSetBits);
+    return transaction.success;
   }
 
-  void giveMutex() {
-    xSemaphoreGive(i2cMutex);
+  boolean transact(uint8_t address, uint32_t clock, i2cTransactionCallback_t run, void* arg) {
+    Transaction transaction;
+    memset(&transaction, 0, sizeof(Transaction));
+    transaction.address = address;
+    transaction.clock = clock;
+    transaction.run = run;
+    transaction.arg = arg;
+    return transact(transaction);
   }
 
-  void initI2C() {
-    if (i2cMutex == NULL) {
-      ESP_LOGE(TAG, "Could not create I2C Mutex");
+  uint8_t getDeviceStats(DeviceStats* stats, uint8_t max) {
+    uint8_t count = devices;
+    for (uint8_t i = 0; i < count && i < max; i++) stats[i] = deviceStats[i];
+    return count;
+  }
+
+  uint32_t getClockChanges() {
+    return clockChanges;
+  }
+
+  void logStats() {
+    DeviceStats stats[I2C_MAX_DEVICES];
+    uint8_t count = getDeviceStats(stats, I2C_MAX_DEVICES);
+    for (uint8_t i = 0; i < count; i++) {
+      ESP_LOGI(TAG, "I2C %x: transactions %u, failed %u, bus time %lu ms, max %u us",
+        stats[i].address, stats[i].transactions, stats[i].failures, (unsigned long)(stats[i].busUs / 1000), stats[i].maxUs);
+    }
+    ESP_LOGI(TAG, "I2C clock changes %u", clockChanges);
+  }
+
+  void initI2C(I2CBackend* _backend, uint32_t stackSize, UBaseType_t priority, BaseType_t core) {
+    backend = _backend;
+    currentClock = Wire.getClock();
+    i2cQueue = xQueueCreate(I2C_QUEUE_LENGTH, sizeof(Transaction*));
+    if (i2cQueue == NULL || xTaskCreatePinnedToCore(i2cLoop, "i2cLoop", stackSize, NULL, priority, &i2cTask, core) != pdPASS) {
+      ESP_LOGE(TAG, "Could not start I2C task");
       delay(1000);
       esp_restart();
     }
-    if (!takeMutex(portMAX_DELAY)) {
-      return;
-    }
-    Wire.setClock(SCD30_I2C_CLK);
-    byte err, addr;
     uint8_t nDevices = 0;
-    for (addr = 1; addr < 127; addr++) {
-      Wire.beginTransmission(addr);
-      err = Wire.endTransmission();
-      if (err == 0) {
+    Transaction probe;
+    memset(&probe, 0, sizeof(Transaction));
+    probe.clock = SCD30_I2C_CLK;
+    for (uint8_t addr = 1; addr < 127; addr++) {
+      probe.address = addr;
+      if (transact(probe, portMAX_DELAY)) {
         nDevices++;
         if (addr == SCD30_I2C_ADR) {
           scd30Detected = true;
@@ -69,19 +176,18 @@ namespace I2C {
         } else {
           ESP_LOGI(TAG, "I2C device found at address %x !", addr);
         }
-      } else if (err == 4) {
-        ESP_LOGW(TAG, "Unknow error at address %x !", addr);
       }
     }
 
     if (nDevices == 0)
       ESP_LOGD(TAG, "No I2C devices found");
-    Wire.setClock(I2C_CLK);
-    giveMutex();
   }
 
   void shutDownI2C() {
+    if (i2cTask) vTaskDelete(i2cTask);
+    i2cTask = NULL;
+    if (i2cQueue) vQueueDelete(i2cQueue);
+    i2cQueue = NULL;
     Wire.~TwoWire();
-    i2cMutex = NULL;
   }
-}
\ No newline at end of file
+}
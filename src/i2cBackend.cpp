@@ -0,0 +1,18 @@
+#include <i2cBackend.h>
+
+WireBackend::WireBackend(TwoWire* wire) {
+  this->wire = wire;
+}
+
+boolean WireBackend::transfer(uint8_t address, const uint8_t* writeBuffer, size_t writeLength, uint8_t* readBuffer, size_t readLength, uint16_t readDelayMs) {
+  if (writeLength > 0 || readLength == 0) {
+    wire->beginTransmission(address);
+    if (writeLength > 0) wire->write(writeBuffer, writeLength);
+    if (wire->endTransmission(readLength == 0 || readDelayMs > 0) != 0) return false;
+  }
+  if (readLength == 0) return true;
+  if (readDelayMs > 0) vTaskDelay(pdMS_TO_TICKS(readDelayMs));
+  if (wire->requestFrom((uint16_t)address, readLength, true) != readLength) return false;
+  for (size_t i = 0; i < readLength; i++) readBuffer[i] = wire->read();
+  return true;
+}
@@ -0,0 +1,72 @@
+#include <latency.h>
+#include <ArduinoJson.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+namespace Latency {
+
+  LatencyHistogram histograms[LS_COUNT];
+  portMUX_TYPE latencyMux = portMUX_INITIALIZER_UNLOCKED;
+
+  void record(LatencyStage stage, uint32_t us) {
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && us > LATENCY_BUCKET_BOUNDS[bucket]) bucket++;
+    portENTER_CRITICAL(&latencyMux);
+    LatencyHistogram* histogram = &histograms[stage];
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->totalUs += us;
+    if (us > histogram->maxUs) histogram->maxUs = us;
+    portEXIT_CRITICAL(&latencyMux);
+  }
+
+  LatencyHistogram getHistogram(LatencyStage stage) {
+    portENTER_CRITICAL(&latencyMux);
+    LatencyHistogram histogram = histograms[stage];
+    portEXIT_CRITICAL(&latencyMux);
+    return histogram;
+  }
+
+  void reset() {
+    portENTER_CRITICAL(&latencyMux);
+    memset(histograms, 0, sizeof(histograms));
+    portEXIT_CRITICAL(&latencyMux);
+  }
+
+  /*
+  {
+    "interval": 300000,
+    "bounds": [100, 250, ... 1000000],
+    "read": { "count": 60, "avg": 4711, "max": 5012, "buckets": [0, 0, 0, 0, 0, 57, 3, 0, 0, 0, 0, 0, 0, 0] },
+    ...
+  }
+  */
+  size_t serializeAndReset(char* buf, size_t size, uint32_t intervalMs) {
+    LatencyHistogram copy[LS_COUNT];
+    portENTER_CRITICAL(&latencyMux);
+    memcpy(copy, histograms, sizeof(histograms));
+    memset(histograms, 0, sizeof(histograms));
+    portEXIT_CRITICAL(&latencyMux);
+
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(LS_COUNT + 2) + JSON_ARRAY_SIZE(LATENCY_BUCKETS - 1)
+      + LS_COUNT * (JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(LATENCY_BUCKETS)));
+    doc["interval"] = intervalMs;
+    JsonArray bounds = doc.createNestedArray("bounds");
+    for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) bounds.add(LATENCY_BUCKET_BOUNDS[i]);
+    for (uint8_t stage = 0; stage < LS_COUNT; stage++) {
+      JsonObject obj = doc.createNestedObject(LATENCY_STAGE_NAMES[stage]);
+      obj["count"] = copy[stage].count;
+      obj["avg"] = copy[stage].count ? (uint32_t)(copy[stage].totalUs / copy[stage].count) : 0;
+      obj["max"] = copy[stage].maxUs;
+      JsonArray buckets = obj.createNestedArray("buckets");
+      for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) buckets.add(copy[stage].buckets[i]);
+    }
+    if (doc.overflowed()) {
+      ESP_LOGW(TAG, "Latency document overflowed");
+      return 0;
+    }
+    return serializeJson(doc, buf, size);
+  }
+
+}
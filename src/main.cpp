@@ -23,12 +23,16 @@
 #include <wifiManager.h>
 #include <ota.h>
 #include <model.h>
+#include <eventBus.h>
+#include <latency.h>
+#include <publishPolicy.h>
 #include <fan.h>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
 
 Model* model;
+PublishPolicy publishPolicy;
 Neopixel* neopixel;
 Buzzer* buzzer;
 SCD30* scd30;
@@ -63,50 +67,55 @@ void setPriorityMessage(char const* msg) {}
 
 void clearPriorityMessage() {}
 
-void modelUpdatedEvt(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus) {
-  if (hasNeoPixel && neopixel) neopixel->update(mask, oldStatus, newStatus);
-  if (hasBuzzer && buzzer) buzzer->update(mask, oldStatus, newStatus);
-  if (fan) fan->update(mask, oldStatus, newStatus);
-  if ((mask & M_PRESSURE) && I2C::scd40Present() && scd40) scd40->setAmbientPressure(model->getPressure());
-  if ((mask & M_PRESSURE) && I2C::scd30Present() && scd30) scd30->setAmbientPressure(model->getPressure());
-  if ((mask & ~M_CONFIG_CHANGED) != M_NONE) {
-    char buf[8];
-    DynamicJsonDocument* doc = new DynamicJsonDocument(512);
-    if (mask & M_CO2) (*doc)["co2"] = model->getCo2();
-    if (mask & M_TEMPERATURE) {
-      sprintf(buf, "%.1f", model->getTemperature());
-      (*doc)["temperature"] = buf;
-    }
-    if (mask & M_HUMIDITY) {
-      sprintf(buf, "%.1f", model->getHumidity());
-      (*doc)["humidity"] = buf;
-    }
-    if (mask & M_PRESSURE) (*doc)["pressure"] = model->getPressure();
-    if (mask & M_IAQ) (*doc)["iaq"] = model->getIAQ();
-    if (mask & M_PM0_5) (*doc)["pm0.5"] = model->getPM0_5();
-    if (mask & M_PM1_0) (*doc)["pm1"] = model->getPM1();
-    if (mask & M_PM2_5) (*doc)["pm2.5"] = model->getPM2_5();
-    if (mask & M_PM4) (*doc)["pm4"] = model->getPM4();
-    if (mask & M_PM10) (*doc)["pm10"] = model->getPM10();
-    (*doc)["fanPwm"] = fan->getFanPwm();
-    mqtt::publishSensors(doc);
-  }
+void updatePressureCompensation(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {
+  uint16_t pressure = data.pressure;
+  if (I2C::scd40Present() && scd40) scd40->setAmbientPressure(pressure);
+  if (I2C::scd30Present() && scd30) scd30->setAmbientPressure(pressure);
+}
+
+void publishMeasurements(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {
+  SensorSample sample;
+  sample.mask = mask;
+  sample.fanPwm = fan->getFanPwm();
+  sample.timestamp = millis();
+  sample.data = data;
+  Latency::recordSince(LS_DISPATCH, sample.data.updated);
+  if (publishPolicy.apply(sample, millis()) == M_NONE) return;
+  mqtt::publishSensors(sample);
 }
 
 void configChanged() {
   model->configurationChanged();
+  mqtt::configurationChanged();
+  if (I2C::scd40Present() && scd40) scd40->setSensorAltitude(config.altitude);
 }
 
-void calibrateCo2SensorCallback(uint16_t co2Reference) {
+// the SCD4x applies calibration and temperature offset with its next measurement and reports the
+// outcome itself, a failure of the SCD3x is returned without touching the SCD4x
+CommandResult calibrateCo2SensorCallback(uint16_t co2Reference, const char* id) {
   ESP_LOGI(TAG, "Starting calibration");
-  if (I2C::scd30Present() && scd30) scd30->calibrateScd30ToReference(co2Reference);
-  if (I2C::scd40Present() && scd40) scd40->calibrateScd40ToReference(co2Reference);
-  vTaskDelay(pdMS_TO_TICKS(200));
+  CommandResult result = CR_FAILED;
+  if (I2C::scd30Present() && scd30) {
+    if (!scd30->calibrateScd30ToReference(co2Reference)) return CR_FAILED;
+    result = CR_OK;
+  }
+  if (I2C::scd40Present() && scd40) result = scd40->calibrateScd40ToReference(co2Reference, id) ? CR_QUEUED : CR_BUSY;
+  return result;
 }
 
-void setTemperatureOffsetCallback(float temperatureOffset) {
-  if (I2C::scd30Present() && scd30) scd30->setTemperatureOffset(temperatureOffset);
-  if (I2C::scd40Present() && scd40) scd40->setTemperatureOffset(temperatureOffset);
+CommandResult setTemperatureOffsetCallback(float temperatureOffset, const char* id) {
+  CommandResult result = CR_FAILED;
+  if (I2C::scd30Present() && scd30) {
+    if (!scd30->setTemperatureOffset(temperatureOffset)) return CR_FAILED;
+    result = CR_OK;
+  }
+  if (I2C::scd40Present() && scd40) result = scd40->setTemperatureOffset(temperatureOffset, id) ? CR_QUEUED : CR_BUSY;
+  return result;
+}
+
+void scd40CommandResult(SCD40CommandType type, const char* id, boolean success, int16_t frcCorrection) {
+  if (type == SCD40_FORCED_RECALIBRATION) mqtt::publishCalibrationResult(id, success, frcCorrection);
+  if (type == SCD40_SET_TEMPERATURE_OFFSET) mqtt::publishCommandResult("setTemperatureOffset", id, success ? CR_OK : CR_FAILED);
 }
 
 float getTemperatureOffsetCallback() {
@@ -116,22 +125,22 @@ float getTemperatureOffsetCallback() {
 }
 
 uint32_t getSPS30AutoCleanInterval() {
-  if (I2C::sps30Present && sps30) return sps30->getAutoCleanInterval();
+  if (I2C::sps30Present() && sps30) return sps30->getAutoCleanInterval();
   return 0;
 }
 
 boolean setSPS30AutoCleanInterval(uint32_t intervalInSeconds) {
-  if (I2C::sps30Present && sps30) return sps30->setAutoCleanInterval(intervalInSeconds);
+  if (I2C::sps30Present() && sps30) return sps30->setAutoCleanInterval(intervalInSeconds);
   return false;
 }
 
 boolean cleanSPS30() {
-  if (I2C::sps30Present && sps30) return sps30->clean();
+  if (I2C::sps30Present() && sps30) return sps30->clean();
   return false;
 }
 
 uint8_t getSPS30Status() {
-  if (I2C::sps30Present && sps30) return sps30->getStatus();
+  if (I2C::sps30Present() && sps30) return sps30->getStatus();
   return false;
 }
 
@@ -172,7 +181,7 @@ void setup() {
   esp_log_level_set("*", ESP_LOG_VERBOSE);
   ESP_LOGI(TAG, "CO2 Monitor v%s. Built from %s @ %s", APP_VERSION, SRC_REVISION, BUILD_TIMESTAMP);
 
-  model = new Model(modelUpdatedEvt);
+  model = new Model(EventBus::publish);
 
   logCoreInfo();
 
@@ -181,6 +190,7 @@ void setup() {
   ESP_ERROR_CHECK(esp_event_loop_create_default());
   ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, WifiManager::eventHandler, NULL, NULL));
   ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, WifiManager::eventHandler, NULL, NULL));
+  ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, mqtt::eventHandler, NULL, NULL));
 
   setupConfigManager();
   if (!loadConfiguration(config)) {
@@ -206,16 +216,34 @@ void setup() {
 
   Wire.begin((int)SDA_PIN, (int)SCL_PIN, (uint32_t)I2C_CLK);
 
-  I2C::initI2C();
+  I2C::initI2C(
+    new WireBackend(&Wire),
+    4096,               // stack size of task
+    3,                  // priority of the task
+    1);                 // CPU core
 
   if (I2C::scd30Present()) scd30 = new SCD30(&Wire, model, updateMessage);
-  if (I2C::scd40Present()) scd40 = new SCD40(&Wire, model, updateMessage);
-  if (I2C::sps30Present()) sps30 = new SPS_30(&Wire, model, updateMessage);
+  if (I2C::scd40Present()) scd40 = new SCD40(&Wire, model, updateMessage, scd40CommandResult);
+  if (I2C::sps30Present()) sps30 = new SPS_30(&Wire, model, updateMessage, mqtt::publishStatusMsg);
 
   if (hasNeoPixel) neopixel = new Neopixel(model, config.neopixelIntData, config.neopixelIntNumber);
   if (hasBuzzer) buzzer = new Buzzer(model, config.buzzerPin);
   fan = new Fan(model);
 
+  EventBus::setup(
+    4096,               // stack size of task
+    2,                  // priority of the task
+    1);                 // CPU core
+  // handlers run in this order, the fan has to come before mqttPublish, which reports its PWM
+  if (hasNeoPixel) EventBus::subscribe("neopixel", M_CO2 | M_CONFIG_CHANGED,
+    +[](uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) { neopixel->update(mask, oldStatus, newStatus, data); });
+  if (hasBuzzer) EventBus::subscribe("buzzer", M_CO2,
+    +[](uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) { buzzer->update(mask, oldStatus, newStatus); });
+  EventBus::subscribe("fan", M_CO2 | M_CONFIG_CHANGED,
+    +[](uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) { fan->update(mask, oldStatus, newStatus, data); });
+  EventBus::subscribe("pressureComp", M_PRESSURE, updatePressureCompensation);
+  EventBus::subscribe("mqttPublish", (uint16_t)~M_CONFIG_CHANGED, publishMeasurements);
+
   mqtt::setupMqtt(
     "CrBox",
     model,
@@ -285,7 +313,7 @@ void loop() {
         prepareOta();
         WifiManager::startCaptivePortal();
       } else if (btnPressTime > 5000) {
-        calibrateCo2SensorCallback(420);
+        calibrateCo2SensorCallback(420, "");
       }
     }
   }
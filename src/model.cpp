@@ -1,122 +1,234 @@
 #include <model.h>
 #include <configManager.h>
+#include <latency.h>
+#include <new>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
 
+// History buffers are allocated once, from PSRAM where available
+template <typename H>
+static H* allocateHistory() {
+#ifndef BOARD_HAS_PSRAM
+  void* buf = malloc(sizeof(H));
+#else
+  void* buf = ps_malloc(sizeof(H));
+#endif
+  if (buf == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate %u bytes for history", sizeof(H));
+    return nullptr;
+  }
+  return new (buf) H();
+}
+
 Model::Model(modelUpdatedEvt_t _modelUpdatedEvt) {
-  this->temperature = NaN;
-  this->humidity = NaN;
-  this->co2 = 0;
-  this->pressure = 0;
-  this->iaq = 0;
-  this->pm0_5 = 0;
-  this->pm1 = 0;
-  this->pm2_5 = 0;
-  this->pm4 = 0;
-  this->pm10 = 0;
+  this->data.temperature = NaN;
+  this->data.humidity = NaN;
+  this->data.co2 = 0;
+  this->data.pressure = 0;
+  this->data.iaq = 0;
+  this->data.pm0_5 = 0;
+  this->data.pm1 = 0;
+  this->data.pm2_5 = 0;
+  this->data.pm4 = 0;
+  this->data.pm10 = 0;
+  this->data.status = OFF;
+  this->sequence = 0;
   this->modelUpdatedEvt = _modelUpdatedEvt;
-  this->status = OFF;
+  this->co2History = allocateHistory<History<uint16_t, HISTORY_LENGTH, 1>>();
+  this->climateHistory = allocateHistory<History<int16_t, HISTORY_LENGTH, 2>>();
+  this->pmHistory = allocateHistory<History<uint16_t, HISTORY_PM_LENGTH, 5>>();
+}
+
+Model::~Model() {
+  if (this->co2History) free(co2History);
+  if (this->climateHistory) free(climateHistory);
+  if (this->pmHistory) free(pmHistory);
+}
+
+void Model::appendHistory(uint16_t mask, const ModelSnapshot& written) {
+  portENTER_CRITICAL(&historyMux);
+  uint32_t now = millis();
+  if ((mask & M_CO2) && co2History) {
+    uint16_t sample[1] = { written.co2 };
+    co2History->append(now, sample);
+  }
+  if ((mask & (M_TEMPERATURE | M_HUMIDITY)) && climateHistory && !isnan(written.temperature) && !isnan(written.humidity)) {
+    int16_t sample[2] = { (int16_t)lroundf(written.temperature * 10), (int16_t)lroundf(written.humidity * 10) };
+    climateHistory->append(now, sample);
+  }
+  if ((mask & M_PM0_5) && pmHistory) {
+    uint16_t sample[5] = { written.pm0_5, written.pm1, written.pm2_5, written.pm4, written.pm10 };
+    pmHistory->append(now, sample);
+  }
+  portEXIT_CRITICAL(&historyMux);
+}
+
+HistoryStats Model::getHistory(HistoryMetric metric, HistoryWindow window) {
+  HistoryStats stats = { NaN, NaN, NaN, 0 };
+  float scale = 1;
+  portENTER_CRITICAL(&historyMux);
+  uint32_t now = millis();
+  if (metric == H_CO2 && co2History) {
+    stats = co2History->getStats(0, window, now);
+  } else if ((metric == H_TEMPERATURE || metric == H_HUMIDITY) && climateHistory) {
+    stats = climateHistory->getStats(metric - H_TEMPERATURE, window, now);
+    scale = 10;
+  } else if (metric >= H_PM0_5 && metric <= H_PM10 && pmHistory) {
+    stats = pmHistory->getStats(metric - H_PM0_5, window, now);
+  }
+  portEXIT_CRITICAL(&historyMux);
+  stats.min /= scale;
+  stats.max /= scale;
+  stats.mean /= scale;
+  return stats;
+}
+
+uint32_t Model::beginWrite() {
+  portENTER_CRITICAL(&writeMux);
+  this->sequence.store(this->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->data.updated = Latency::now();
+  return this->data.updated;
+}
+
+void Model::endWrite() {
+  this->sequence.store(this->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  portEXIT_CRITICAL(&writeMux);
 }
 
-Model::~Model() {}
+ModelSnapshot Model::snapshot() {
+  ModelSnapshot copy;
+  uint32_t before, after;
+  do {
+    before = this->sequence.load(std::memory_order_acquire);
+    copy = this->data;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = this->sequence.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  return copy;
+}
 
 void Model::updateStatus() {
   TrafficLightStatus co2Status = OFF;
-  if (this->co2 != 0) {
-    if (this->co2 <= config.co2YellowThreshold) {
+  if (this->data.co2 != 0) {
+    if (this->data.co2 <= config.co2YellowThreshold) {
       co2Status = GREEN;
-    } else if (this->co2 <= config.co2RedThreshold) {
+    } else if (this->data.co2 <= config.co2RedThreshold) {
       co2Status = YELLOW;
-    } else if (this->co2 <= config.co2DarkRedThreshold) {
+    } else if (this->data.co2 <= config.co2DarkRedThreshold) {
       co2Status = RED;
     } else {
       co2Status = DARK_RED;
     }
   }
+  this->data.status = co2Status;
   //  ESP_LOGD(TAG, "UpdateStatus CO2: %i (%u), IAQ: %i (%u) ==> %i", co2Status, this->co2, iaqStatus, this->iaq, this->status);
 }
 
 void Model::updateModel(uint16_t _co2) {
-  this->co2 = _co2;
-  TrafficLightStatus oldStatus = this->status;
+  uint32_t start = beginWrite();
+  TrafficLightStatus oldStatus = this->data.status;
+  this->data.co2 = _co2;
   this->updateStatus();
-  modelUpdatedEvt((_co2 != 0 ? M_CO2 : M_NONE), oldStatus, this->status);
+  ModelSnapshot written = this->data;
+  endWrite();
+  appendHistory(_co2 != 0 ? M_CO2 : M_NONE, written);
+  modelUpdatedEvt((_co2 != 0 ? M_CO2 : M_NONE), oldStatus, written.status, written);
+  Latency::recordSince(LS_MODEL_UPDATE, start);
 }
 
 void Model::updateModel(uint16_t _co2, float _temperature, float _humidity) {
-  this->co2 = _co2;
-  this->temperature = _temperature;
-  this->humidity = _humidity;
-  TrafficLightStatus oldStatus = this->status;
+  uint32_t start = beginWrite();
+  TrafficLightStatus oldStatus = this->data.status;
+  this->data.co2 = _co2;
+  this->data.temperature = _temperature;
+  this->data.humidity = _humidity;
   this->updateStatus();
-  modelUpdatedEvt((_co2 != 0 ? M_CO2 : M_NONE) | M_TEMPERATURE | M_HUMIDITY, oldStatus, this->status);
+  ModelSnapshot written = this->data;
+  endWrite();
+  appendHistory((_co2 != 0 ? M_CO2 : M_NONE) | M_TEMPERATURE | M_HUMIDITY, written);
+  modelUpdatedEvt((_co2 != 0 ? M_CO2 : M_NONE) | M_TEMPERATURE | M_HUMIDITY, oldStatus, written.status, written);
+  Latency::recordSince(LS_MODEL_UPDATE, start);
 }
 
 void Model::updateModel(float _temperature, float _humidity, uint16_t _pressure, uint16_t _iaq) {
-  this->temperature = _temperature;
-  this->humidity = _humidity;
-  this->pressure = _pressure;
-  this->iaq = _iaq;
-  TrafficLightStatus oldStatus = this->status;
+  uint32_t start = beginWrite();
+  TrafficLightStatus oldStatus = this->data.status;
+  this->data.temperature = _temperature;
+  this->data.humidity = _humidity;
+  this->data.pressure = _pressure;
+  this->data.iaq = _iaq;
   this->updateStatus();
-  modelUpdatedEvt(M_TEMPERATURE | M_HUMIDITY | M_PRESSURE | (_iaq != 0 ? M_IAQ : M_NONE), oldStatus, this->status);
+  ModelSnapshot written = this->data;
+  endWrite();
+  appendHistory(M_TEMPERATURE | M_HUMIDITY, written);
+  modelUpdatedEvt(M_TEMPERATURE | M_HUMIDITY | M_PRESSURE | (_iaq != 0 ? M_IAQ : M_NONE), oldStatus, written.status, written);
+  Latency::recordSince(LS_MODEL_UPDATE, start);
 }
 
 void Model::updateModel(uint16_t _pm0_5, uint16_t _pm1, uint16_t _pm2_5, uint16_t _pm4, uint16_t _pm10) {
-  this->pm0_5 = _pm0_5;
-  this->pm1 = _pm1;
-  this->pm2_5 = _pm2_5;
-  this->pm4 = _pm4;
-  this->pm10 = _pm10;
-  modelUpdatedEvt(M_PM0_5 | M_PM1_0 | M_PM2_5 | M_PM4 | M_PM10, this->status, this->status);
+  uint32_t start = beginWrite();
+  this->data.pm0_5 = _pm0_5;
+  this->data.pm1 = _pm1;
+  this->data.pm2_5 = _pm2_5;
+  this->data.pm4 = _pm4;
+  this->data.pm10 = _pm10;
+  ModelSnapshot written = this->data;
+  endWrite();
+  appendHistory(M_PM0_5 | M_PM1_0 | M_PM2_5 | M_PM4 | M_PM10, written);
+  modelUpdatedEvt(M_PM0_5 | M_PM1_0 | M_PM2_5 | M_PM4 | M_PM10, written.status, written.status, written);
+  Latency::recordSince(LS_MODEL_UPDATE, start);
 }
 
 void Model::configurationChanged() {
+  beginWrite();
   updateStatus();
-  modelUpdatedEvt(M_CONFIG_CHANGED, this->status, this->status);
+  ModelSnapshot written = this->data;
+  endWrite();
+  modelUpdatedEvt(M_CONFIG_CHANGED, written.status, written.status, written);
 }
 
 TrafficLightStatus Model::getStatus() {
-  return this->status;
+  return this->data.status;
 }
 
 uint16_t Model::getCo2() {
-  return this->co2;
+  return this->data.co2;
 }
 
 float Model::getTemperature() {
-  return this->temperature;
+  return this->data.temperature;
 }
 
 float Model::getHumidity() {
-  return this->humidity;
+  return this->data.humidity;
 }
 
 uint16_t Model::getPressure() {
-  return this->pressure;
+  return this->data.pressure;
 }
 
 uint16_t Model::getIAQ() {
-  return this->iaq;
+  return this->data.iaq;
 }
 
 uint16_t Model::getPM0_5() {
-  return this->pm0_5;
+  return this->data.pm0_5;
 }
 
 uint16_t Model::getPM1() {
-  return this->pm1;
+  return this->data.pm1;
 }
 
 uint16_t Model::getPM2_5() {
-  return this->pm2_5;
+  return this->data.pm2_5;
 }
 
 uint16_t Model::getPM4() {
-  return this->pm4;
+  return this->data.pm4;
 }
 
 uint16_t Model::getPM10() {
-  return this->pm10;
+  return this->data.pm10;
 }
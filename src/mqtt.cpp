@@ -4,36 +4,85 @@
 
 #include <PubSubClient.h>
 #include <WiFiClient.h>
-#include <WiFiClientSecure.h>
+#include <tlsClient.h>
 #include <i2c.h>
 #include <configManager.h>
 #include <wifiManager.h>
 #include <ota.h>
 
 #include <LittleFS.h>
+#include <lwip/sockets.h>
+#include <sampleStore.h>
+#include <latency.h>
+#include <mqttCommands.h>
+#include <pemValidator.h>
+#include <commandWorker.h>
+#include <backoff.h>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
 
+// <topic>/<id>/up/sensors/replay/msgpack
+#define MQTT_TOPIC_BUF_LEN (MQTT_TOPIC_LEN + 40)
+#define CERT_WRITE_CHUNK 512
+
 namespace mqtt {
 
+  // control traffic only, sensor data goes through the sensor slot
   struct MqttMessage {
-    uint8_t cmd;
-    DynamicJsonDocument* payload;
+    uint16_t cmd;
     char* statusMessage;
+    Config* config;
   };
 
-  const uint8_t X_CMD_PUBLISH_SENSORS = bit(0);
-  const uint8_t X_CMD_PUBLISH_CONFIGURATION = bit(1);
-  const uint8_t X_CMD_PUBLISH_STATUS_MSG = bit(2);
-  const uint8_t X_CMD_SHUTDOWN = bit(3);
+  const uint16_t X_CMD_DISCONNECT = bit(0);
+  const uint16_t X_CMD_PUBLISH_CONFIGURATION = bit(1);
+  const uint16_t X_CMD_PUBLISH_STATUS_MSG = bit(2);
+  const uint16_t X_CMD_SHUTDOWN = bit(3);
+  const uint16_t X_CMD_CONFIG_CHANGED = bit(4);
+  const uint16_t X_CMD_PUBLISH_COMMAND_RESULT = bit(5);
+  const uint16_t X_CMD_PUBLISH_TELEMETRY = bit(6);
+  const uint16_t X_CMD_APPLY_CONFIG = bit(7);
+  const uint16_t X_CMD_PUBLISH_TRENDS = bit(8);
+
+  // task notifications, something was queued or put into the sensor slot / the broker sent something
+  const uint32_t X_NOTIFY_WORK = bit(0);
+  const uint32_t X_NOTIFY_SOCKET = bit(1);
+
+  // formatted once from config, rebuilt by the mqtt task when the configuration changes
+  struct Topics {
+    char upSensors[MQTT_TOPIC_BUF_LEN];
+    char upSensorsMsgPack[MQTT_TOPIC_BUF_LEN];
+    char upSensorsReplay[MQTT_TOPIC_BUF_LEN];
+    char upSensorsReplayMsgPack[MQTT_TOPIC_BUF_LEN];
+    char upStatus[MQTT_TOPIC_BUF_LEN];
+    char upConfig[MQTT_TOPIC_BUF_LEN];
+    char upMetrics[MQTT_TOPIC_BUF_LEN];
+    char downDevice[MQTT_TOPIC_BUF_LEN];
+    char downAll[MQTT_TOPIC_BUF_LEN];
+    char subscribeDevice[MQTT_TOPIC_BUF_LEN];
+    char subscribeAll[MQTT_TOPIC_BUF_LEN];
+    char mirrorUp[MQTT_TOPIC_BUF_LEN];
+    char mirrorSensors[MQTT_TOPIC_BUF_LEN];
+    char mirrorSensorsMsgPack[MQTT_TOPIC_BUF_LEN];
+    size_t downDeviceLen;
+    size_t downAllLen;
+    size_t mirrorUpLen;
+  };
 
   TaskHandle_t mqttTask;
   QueueHandle_t mqttQueue;
 
   volatile boolean shutdownInProgress = false;
+  volatile boolean mqttTaskParked = false;
+  // set by the command worker while it tests a connection, the mqtt task doesn't reconnect meanwhile
+  volatile boolean connectionTestRunning = false;
+  SemaphoreHandle_t disconnected;
 
-  WiFiClient* wifiClient;
+  Client* wifiClient;
+  // chosen in setupMqtt(), a changed mqttUseTls takes effect after a reboot
+  boolean wifiClientTls = false;
+  TlsCredentials* mqttCredentials;
   PubSubClient* mqtt_client;
   Model* model;
 
@@ -48,9 +97,68 @@ namespace mqtt {
   getSPS30StatusCallback_t getSPS30StatusCallback;
   configChangedCallback_t configChangedCallback;
 
-  uint32_t lastReconnectAttempt = 0;
   uint16_t connectionAttempts = 0;
 
+  // reconnect state, only accessed from the mqtt task except ipAcquired
+  Backoff reconnectBackoff(0, 0);   // set up from config in setupMqtt()
+  uint32_t nextReconnectAttempt = 0;
+  uint32_t disconnectedSince = 0;
+  boolean wasConnected = false;
+  uint32_t connectedSince = 0;
+  volatile boolean ipAcquired = false;
+
+  // only accessed from the mqtt task
+  SensorSample batch[SENSORS_BATCH_MAX];
+  uint8_t batchCount = 0;
+  char batchMsg[SENSOR_BATCH_JSON_SIZE];
+  SampleStore* offlineStore;
+  uint32_t lastReplay = 0;
+  uint32_t lastMetrics = 0;
+  uint32_t loopWakeups = 0;
+  // PubSubClient pings once MQTT_KEEPALIVE_S passed since it last read or wrote a packet, these are
+  // taken right after its own timestamps so the keepalive deadline is never ahead of its check
+  uint32_t lastPacketIn = 0;
+  uint32_t lastPacketOut = 0;
+
+  // wakes the mqtt task when the broker sent something, armed by the mqtt task for one socket at a time
+  TaskHandle_t socketWatchTask;
+  volatile int watchedSocket = -1;
+  volatile boolean socketWatchArmed = false;
+
+  // latest value wins slot for sensor data, drained once the control queue is empty
+  portMUX_TYPE schedulerMux = portMUX_INITIALIZER_UNLOCKED;
+  SensorSample sensorSlot;
+  uint32_t sensorSlotQueued;
+  volatile boolean sensorSlotPending = false;
+  MqttQueueStats queueStats;
+  // written by the mqtt task only
+  MqttConnectionStats connectionStats;
+  Topics topics;
+  // zero terminated copy of command payloads, certs are streamed from the PubSubClient buffer instead
+  char commandPayload[CONFIG_SIZE];
+  uint32_t commandSequence = 0;
+
+  Backoff configuredBackoff() {
+    return Backoff(config.mqttReconnectMin * 1000UL, max(config.mqttReconnectMin, config.mqttReconnectMax) * 1000UL);
+  }
+
+  void buildTopics() {
+    snprintf(topics.upSensors, MQTT_TOPIC_BUF_LEN, "%s/%u/up/sensors", config.mqttTopic, config.deviceId);
+    snprintf(topics.upSensorsMsgPack, MQTT_TOPIC_BUF_LEN, "%s/%u/up/sensors/msgpack", config.mqttTopic, config.deviceId);
+    snprintf(topics.upSensorsReplay, MQTT_TOPIC_BUF_LEN, "%s/%u/up/sensors/replay", config.mqttTopic, config.deviceId);
+    snprintf(topics.upSensorsReplayMsgPack, MQTT_TOPIC_BUF_LEN, "%s/%u/up/sensors/replay/msgpack", config.mqttTopic, config.deviceId);
+    snprintf(topics.upStatus, MQTT_TOPIC_BUF_LEN, "%s/%u/up/status", config.mqttTopic, config.deviceId);
+    snprintf(topics.upConfig, MQTT_TOPIC_BUF_LEN, "%s/%u/up/config", config.mqttTopic, config.deviceId);
+    snprintf(topics.upMetrics, MQTT_TOPIC_BUF_LEN, "%s/%u/up/metrics", config.mqttTopic, config.deviceId);
+    topics.downDeviceLen = snprintf(topics.downDevice, MQTT_TOPIC_BUF_LEN, "%s/%u/down/", config.mqttTopic, config.deviceId);
+    topics.downAllLen = snprintf(topics.downAll, MQTT_TOPIC_BUF_LEN, "%s/down/", config.mqttTopic);
+    snprintf(topics.subscribeDevice, MQTT_TOPIC_BUF_LEN, "%s#", topics.downDevice);
+    snprintf(topics.subscribeAll, MQTT_TOPIC_BUF_LEN, "%s#", topics.downAll);
+    topics.mirrorUpLen = snprintf(topics.mirrorUp, MQTT_TOPIC_BUF_LEN, "%s/%u/up/", config.mqttMirrorTopic, config.mqttMirrordeviceId);
+    snprintf(topics.mirrorSensors, MQTT_TOPIC_BUF_LEN, "%ssensors", topics.mirrorUp);
+    snprintf(topics.mirrorSensorsMsgPack, MQTT_TOPIC_BUF_LEN, "%ssensors/msgpack", topics.mirrorUp);
+  }
+
   char* cloneStr(const char* original) {
     char* copy = (char*)malloc(strlen(original) + 1);
     strncpy(copy, original, strlen(original));
@@ -58,84 +166,283 @@ namespace mqtt {
     return copy;
   }
 
-  void publishSensors(DynamicJsonDocument* _payload) {
-    if (config.mqttMirrorDevice) {
-      delete _payload;
-      return;
+  boolean isMqttHostConfigured() {
+    return strncmp(config.mqttHost, "127.0.0.1", MQTT_HOSTNAME_LEN) != 0
+      && strncmp(config.mqttHost, "localhost", MQTT_HOSTNAME_LEN) != 0;
+  }
+
+  // samples are queued even while disconnected, the mqtt task keeps them in the offline store
+  // queues a control message and wakes the mqtt task, the message is dropped if the queue stays full
+  boolean enqueue(MqttMessage& msg, boolean toFront = false) {
+    // the mqtt task must not wait for its own queue
+    TickType_t wait = xTaskGetCurrentTaskHandle() == mqttTask ? 0 : pdMS_TO_TICKS(100);
+    if (!mqttQueue || !(toFront ? xQueueSendToFront(mqttQueue, (void*)&msg, wait) : xQueueSendToBack(mqttQueue, (void*)&msg, wait))) {
+      portENTER_CRITICAL(&schedulerMux);
+      queueStats.controlDropped++;
+      portEXIT_CRITICAL(&schedulerMux);
+      return false;
     }
-    if (!WiFi.isConnected() || !mqtt_client->connected() || shutdownInProgress) {
-      delete _payload;
-      return;
+    UBaseType_t waiting = uxQueueMessagesWaiting(mqttQueue);
+    portENTER_CRITICAL(&schedulerMux);
+    if (waiting > queueStats.controlHighWater) queueStats.controlHighWater = waiting;
+    portEXIT_CRITICAL(&schedulerMux);
+    if (mqttTask) xTaskNotify(mqttTask, X_NOTIFY_WORK, eSetBits);
+    return true;
+  }
+
+  // never blocks, a sample arriving while the previous one is still waiting is merged into it
+  void publishSensors(const SensorSample& sample) {
+    if (config.mqttMirrorDevice) return;
+    if (!isMqttHostConfigured() || shutdownInProgress) return;
+    uint32_t now = Latency::now();
+    portENTER_CRITICAL(&schedulerMux);
+    if (sensorSlotPending) {
+      queueStats.metricsCoalesced += coalesceSensorSample(sensorSlot, sample);
+      queueStats.samplesCoalesced++;
+    } else {
+      sensorSlot = sample;
+      sensorSlotQueued = now;
+      sensorSlotPending = true;
     }
-    MqttMessage msg;
-    msg.cmd = X_CMD_PUBLISH_SENSORS;
-    msg.payload = _payload;
-    if (!mqttQueue || !xQueueSendToBack(mqttQueue, (void*)&msg, pdMS_TO_TICKS(100))) {
-      delete msg.payload;
+    portEXIT_CRITICAL(&schedulerMux);
+    if (mqttTask) xTaskNotify(mqttTask, X_NOTIFY_WORK, eSetBits);
+  }
+
+  boolean takeSensorSlot(SensorSample& sample, uint32_t& queued) {
+    if (!sensorSlotPending) return false;
+    portENTER_CRITICAL(&schedulerMux);
+    sample = sensorSlot;
+    queued = sensorSlotQueued;
+    sensorSlotPending = false;
+    portEXIT_CRITICAL(&schedulerMux);
+    return true;
+  }
+
+  MqttQueueStats getQueueStats() {
+    portENTER_CRITICAL(&schedulerMux);
+    MqttQueueStats stats = queueStats;
+    portEXIT_CRITICAL(&schedulerMux);
+    return stats;
+  }
+
+  // fields may be from slightly different moments when called from another task
+  MqttConnectionStats getConnectionStats() {
+    MqttConnectionStats stats = connectionStats;
+    if (wasConnected) stats.connectedMs += millis() - connectedSince;
+    return stats;
+  }
+
+  // all publishes on the main connection go through here to be counted
+  boolean publish(const char* topic, const uint8_t* payload, size_t length) {
+    connectionStats.publishes++;
+    if (!mqtt_client->publish(topic, payload, length)) {
+      connectionStats.publishFailures++;
+      return false;
     }
+    lastPacketOut = millis();
+    connectionStats.bytesSent += strlen(topic) + length;
+    return true;
   }
 
-  boolean publishSensorsInternal(MqttMessage queueMsg) {
-    char topic[256];
-    char msg[256];
-    sprintf(topic, "%s/%u/up/sensors", config.mqttTopic, config.deviceId);
+  boolean publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload));
+  }
 
-    // Serialize JSON to file
-    if (serializeJson(*queueMsg.payload, msg) == 0) {
+  boolean publishSensorsInternal(const SensorSample& sample) {
+    char msg[SENSOR_SAMPLE_JSON_SIZE];
+    const char* topic = config.mqttMsgPack ? topics.upSensorsMsgPack : topics.upSensors;
+    size_t len = serializeSensorSample(sample, msg, sizeof(msg), config.mqttMsgPack ? SSE_MSGPACK : SSE_JSON);
+    if (len == 0) {
       ESP_LOGW(TAG, "Failed to serialise payload");
-      delete queueMsg.payload;
       return true; // pretend to have been successful to prevent queue from clogging up
     }
-    if (strncmp(msg, "null", 4) == 0) {
-      ESP_LOGD(TAG, "Nothing to publish");
-      delete queueMsg.payload;
-      return true; // pretend to have been successful to prevent queue from clogging up
+    ESP_LOGD(TAG, "Publishing sensor values: %s:%s", topic, config.mqttMsgPack ? "<msgpack>" : msg);
+    uint32_t start = Latency::now();
+    if (!publish(topic, (uint8_t*)msg, len)) {
+      ESP_LOGI(TAG, "publish sensors failed!");
+      return false;
+    }
+    Latency::recordSince(LS_PUBLISH, start);
+    Latency::recordSince(LS_END_TO_END, sample.data.updated);
+    return true;
+  }
+
+  // replayed readings get their own topic, consumers of live data such as mirroring boxes don't see them
+  boolean publishSamplesInternal(const SensorSample* samples, uint8_t count, boolean replay = false, boolean previousBoot = false) {
+    const char* topic = replay ? (config.mqttMsgPack ? topics.upSensorsReplayMsgPack : topics.upSensorsReplay)
+      : (config.mqttMsgPack ? topics.upSensorsMsgPack : topics.upSensors);
+    size_t len = serializeSensorSamples(samples, count, millis(), batchMsg, sizeof(batchMsg), config.mqttMsgPack ? SSE_MSGPACK : SSE_JSON, previousBoot);
+    if (len == 0) {
+      ESP_LOGW(TAG, "Failed to serialise payload");
+      return true;
     }
-    ESP_LOGD(TAG, "Publishing sensor values: %s:%s", topic, msg);
-    if (!mqtt_client->publish(topic, msg)) {
+    ESP_LOGD(TAG, "Publishing %u sensor samples: %s:%s", count, topic, config.mqttMsgPack ? "<msgpack>" : batchMsg);
+    uint32_t start = Latency::now();
+    if (!publish(topic, (uint8_t*)batchMsg, len)) {
       ESP_LOGI(TAG, "publish sensors failed!");
       return false;
     }
-    delete queueMsg.payload;
+    Latency::recordSince(LS_PUBLISH, start);
     return true;
   }
 
-  void publishConfiguration() {
+  void storeOffline(const SensorSample& sample) {
+    uint32_t dropped = offlineStore->getDropped();
+    offlineStore->append(sample);
+    // once per page while the store is full
+    if (offlineStore->getDropped() != dropped)
+      ESP_LOGW(TAG, "Offline store full, %u oldest samples dropped", offlineStore->getDropped());
+  }
+
+  void publishBatchInternal() {
+    uint8_t count = batchCount;
+    batchCount = 0;
+    if (!publishSamplesInternal(batch, count)) {
+      for (uint8_t i = 0; i < count; i++) storeOffline(batch[i]);
+    } else {
+      // replayed samples are left out, their time offline would swamp the histogram
+      for (uint8_t i = 0; i < count; i++) Latency::recordSince(LS_END_TO_END, batch[i].data.updated);
+    }
+  }
+
+  // replays stored samples in batches, at most one batch per OFFLINE_REPLAY_INTERVAL_MS
+  void replayOffline() {
+    if (offlineStore->size() == 0 || millis() - lastReplay < OFFLINE_REPLAY_INTERVAL_MS) return;
+    lastReplay = millis();
+    SensorSample samples[SENSORS_BATCH_MAX];
+    boolean previousBoot;
+    uint8_t count = offlineStore->read(samples, SENSORS_BATCH_MAX, &previousBoot);
+    if (count == 0 || !publishSamplesInternal(samples, count, true, previousBoot)) return;
+    offlineStore->consume(count);
+    if (offlineStore->size() == 0) ESP_LOGI(TAG, "Replayed all offline samples");
+  }
+
+  void publishMetricsInternal() {
+    char buf[LATENCY_JSON_SIZE];
+    uint32_t interval = millis() - lastMetrics;
+    lastMetrics = millis();
+    size_t len = Latency::serializeAndReset(buf, sizeof(buf), interval);
+    if (len == 0) return;
+    ESP_LOGD(TAG, "Publishing latency metrics: %s:%s", topics.upMetrics, buf);
+    if (!publish(topics.upMetrics, buf)) {
+      ESP_LOGI(TAG, "publish metrics failed!");
+    }
+  }
+
+  boolean publishTelemetryInternal() {
+    char msg[MQTT_TELEMETRY_JSON_SIZE];
+    MqttQueueStats queue = getQueueStats();
+    MqttConnectionStats connection = getConnectionStats();
+    StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(18)> doc;
+    JsonObject telemetry = doc.createNestedObject("telemetry");
+    telemetry["uptime"] = (uint32_t)(esp_timer_get_time() / 1000000);
+    telemetry["connectedTime"] = (uint32_t)(connection.connectedMs / 1000);
+    telemetry["connects"] = connection.connects;
+    telemetry["disconnects"] = connection.disconnects;
+    telemetry["reconnectMs"] = connection.lastReconnectMs;
+    telemetry["maxReconnectMs"] = connection.maxReconnectMs;
+    telemetry["rssi"] = WiFi.RSSI();
+    telemetry["publishes"] = connection.publishes;
+    telemetry["publishFailures"] = connection.publishFailures;
+    telemetry["bytesSent"] = connection.bytesSent;
+    telemetry["bytesReceived"] = connection.bytesReceived;
+    telemetry["queueHighWater"] = queue.controlHighWater;
+    telemetry["queueDropped"] = queue.controlDropped;
+    telemetry["samplesCoalesced"] = queue.samplesCoalesced;
+    telemetry["metricsCoalesced"] = queue.metricsCoalesced;
+    telemetry["offlineStored"] = offlineStore->size();
+    telemetry["offlineDropped"] = offlineStore->getDropped();
+    telemetry["wakeups"] = loopWakeups;
+    if (serializeJson(doc, msg) == 0) {
+      ESP_LOGW(TAG, "Failed to serialise payload");
+      return true; // pretend to have been successful to prevent queue from clogging up
+    }
+    ESP_LOGD(TAG, "Publishing telemetry: %s:%s", topics.upStatus, msg);
+    if (!publish(topics.upStatus, msg)) {
+      ESP_LOGI(TAG, "publish telemetry failed!");
+      return false;
+    }
+    return true;
+  }
+
+  void publishTelemetry() {
     MqttMessage msg;
-    msg.cmd = X_CMD_PUBLISH_CONFIGURATION;
+    msg.cmd = X_CMD_PUBLISH_TELEMETRY;
     msg.statusMessage = nullptr;
-    if (mqttQueue) xQueueSendToBack(mqttQueue, (void*)&msg, pdMS_TO_TICKS(100));
+    enqueue(msg);
   }
 
-  void setMqttCerts(WiFiClientSecure* wifiClient, const char* mqttRootCertFilename, const char* mqttClientKeyFilename, const char* mqttClientCertFilename) {
-    File root_ca_file = LittleFS.open(mqttRootCertFilename, FILE_READ);
-    if (root_ca_file) {
-      ESP_LOGD(TAG, "Loading MQTT root ca from FS (%s)", mqttRootCertFilename);
-      wifiClient->loadCACert(root_ca_file, root_ca_file.size());
-      root_ca_file.close();
+  const char* const TREND_METRICS[] = { "co2", "temperature", "humidity", "pm0.5", "pm1", "pm2.5", "pm4", "pm10" };
+  const char* const TREND_WINDOWS[HW_COUNT] = { "1min", "15min", "1h" };
+
+  // min, max and mean of each metric with readings in the last hour, from the model's history
+  boolean publishTrendsInternal() {
+    char msg[MQTT_TRENDS_JSON_SIZE];
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(H_PM10 + 1) + (H_PM10 + 1) * (JSON_OBJECT_SIZE(HW_COUNT) + HW_COUNT * JSON_OBJECT_SIZE(4)));
+    JsonObject trends = doc.createNestedObject("trends");
+    for (uint8_t metric = H_CO2; metric <= H_PM10; metric++) {
+      if (model->getHistory((HistoryMetric)metric, HW_1H).count == 0) continue;
+      JsonObject windows = trends.createNestedObject(TREND_METRICS[metric]);
+      for (uint8_t window = HW_1MIN; window < HW_COUNT; window++) {
+        HistoryStats stats = model->getHistory((HistoryMetric)metric, (HistoryWindow)window);
+        JsonObject obj = windows.createNestedObject(TREND_WINDOWS[window]);
+        obj["count"] = stats.count;
+        if (stats.count == 0) continue;
+        obj["min"] = roundf(stats.min * 10) / 10;
+        obj["max"] = roundf(stats.max * 10) / 10;
+        obj["mean"] = roundf(stats.mean * 10) / 10;
+      }
     }
-    File client_key_file = LittleFS.open(mqttClientKeyFilename, FILE_READ);
-    if (client_key_file) {
-      ESP_LOGD(TAG, "Loading MQTT client key from FS (%s)", mqttClientKeyFilename);
-      wifiClient->loadPrivateKey(client_key_file, client_key_file.size());
-      client_key_file.close();
+    if (doc.overflowed() || serializeJson(doc, msg) == 0) {
+      ESP_LOGW(TAG, "Failed to serialise payload");
+      return true; // pretend to have been successful to prevent queue from clogging up
     }
-    File client_cert_file = LittleFS.open(mqttClientCertFilename, FILE_READ);
-    if (client_cert_file) {
-      ESP_LOGD(TAG, "Loading MQTT client cert from FS (%s)", mqttClientCertFilename);
-      wifiClient->loadCertificate(client_cert_file, client_cert_file.size());
-      client_cert_file.close();
+    ESP_LOGD(TAG, "Publishing trends: %s:%s", topics.upStatus, msg);
+    if (!publish(topics.upStatus, msg)) {
+      ESP_LOGI(TAG, "publish trends failed!");
+      return false;
     }
+    return true;
   }
 
-  boolean testMqttConfig(WiFiClient* wifiClient, Config testConfig) {
+  void publishTrends() {
+    MqttMessage msg;
+    msg.cmd = X_CMD_PUBLISH_TRENDS;
+    msg.statusMessage = nullptr;
+    enqueue(msg);
+  }
+
+  void addToBatch(const SensorSample& sample) {
+    batch[batchCount++] = sample;
+    if (batchCount >= min(config.sensorsBatchSize, (uint8_t)SENSORS_BATCH_MAX)) publishBatchInternal();
+  }
+
+  void publishConfiguration() {
+    MqttMessage msg;
+    msg.cmd = X_CMD_PUBLISH_CONFIGURATION;
+    msg.statusMessage = nullptr;
+    enqueue(msg);
+  }
+
+  // the mqtt task owns mqtt_client, other tasks ask it to disconnect and wait until it has
+  void requestDisconnect() {
+    MqttMessage msg;
+    msg.cmd = X_CMD_DISCONNECT;
+    msg.statusMessage = nullptr;
+    xSemaphoreTake(disconnected, 0);
+    if (!enqueue(msg, true) || xSemaphoreTake(disconnected, pdMS_TO_TICKS(MQTT_DISCONNECT_WAIT_MS)) != pdTRUE)
+      ESP_LOGW(TAG, "MQTT connection not closed for the test");
+  }
+
+  boolean testMqttConfig(Client* wifiClient, const Config& testConfig) {
     char buf[128];
     boolean mqttTestSuccess;
     PubSubClient* testMqttClient = new PubSubClient(*wifiClient);
     testMqttClient->setServer(testConfig.mqttHost, testConfig.mqttServerPort);
     sprintf(buf, "%s-%u-%s", appName, testConfig.deviceId, WifiManager::getMac().c_str());
+    connectionTestRunning = true;
     // disconnect current connection if not enough heap avalable to initiate another tls session.
-    if (testConfig.mqttUseTls && ESP.getFreeHeap() < 75000) mqtt_client->disconnect();
+    if (testConfig.mqttUseTls && ESP.getFreeHeap() < 75000) requestDisconnect();
     mqttTestSuccess = testMqttClient->connect(buf, testConfig.mqttUsername, testConfig.mqttPassword);
     if (mqttTestSuccess) {
       ESP_LOGD(TAG, "Test MQTT connected");
@@ -144,6 +451,8 @@ namespace mqtt {
       if (!mqttTestSuccess) ESP_LOGI(TAG, "connecting using new mqtt settings failed!");
     }
     delete testMqttClient;
+    connectionTestRunning = false;
+    if (mqttTask) xTaskNotify(mqttTask, X_NOTIFY_WORK, eSetBits);
     return mqttTestSuccess;
   }
 
@@ -167,29 +476,35 @@ namespace mqtt {
     }
 
     for (ConfigParameterBase<Config>* configParameter : getConfigParameters()) {
-      if (!(strncmp(configParameter->getId(), "deviceId", strlen(buf)) == 0)
-        && !(strncmp(configParameter->getId(), "mqttPassword", strlen(buf)) == 0))
+      if (strcmp(configParameter->getId(), "deviceId") != 0
+        && strcmp(configParameter->getId(), "mqttPassword") != 0)
         configParameter->toJson(config, &doc);
     }
 
     float tempOffset = getTemperatureOffsetCallback();
-    if (tempOffset != NaN) {
-      sprintf(buf, "%.1f", getTemperatureOffsetCallback());
+    if (!isnan(tempOffset)) {
+      sprintf(buf, "%.1f", tempOffset);
       doc["tempOffset"] = buf;
     }
     if (serializeJson(doc, msg) == 0) {
       ESP_LOGW(TAG, "Failed to serialise payload");
       return true; // pretend to have been successful to prevent queue from clogging up
     }
-    sprintf(buf, "%s/%u/up/config", config.mqttTopic, config.deviceId);
-    ESP_LOGI(TAG, "Publishing configuration: %s:%s", buf, msg);
-    if (!mqtt_client->publish(buf, msg)) {
+    ESP_LOGI(TAG, "Publishing configuration: %s:%s", topics.upConfig, msg);
+    if (!publish(topics.upConfig, msg)) {
       ESP_LOGI(TAG, "publish configuration failed!");
       return false;
     }
     return true;
   }
 
+  void configurationChanged() {
+    MqttMessage msg;
+    msg.cmd = X_CMD_CONFIG_CHANGED;
+    msg.statusMessage = nullptr;
+    enqueue(msg);
+  }
+
   void publishStatusMsg(const char* statusMessage) {
     if (strlen(statusMessage) > 200) {
       ESP_LOGW(TAG, "msg too long - discarding");
@@ -198,9 +513,46 @@ namespace mqtt {
     MqttMessage msg;
     msg.cmd = X_CMD_PUBLISH_STATUS_MSG;
     msg.statusMessage = cloneStr(statusMessage);
-    if (!mqttQueue || !xQueueSendToBack(mqttQueue, (void*)&msg, pdMS_TO_TICKS(100))) {
-      free(msg.statusMessage);
+    if (!enqueue(msg)) free(msg.statusMessage);
+  }
+
+  void enqueueCommandResult(const JsonDocument& doc) {
+    char buf[128];
+    if (serializeJson(doc, buf, sizeof(buf)) == 0) {
+      ESP_LOGW(TAG, "Failed to serialise payload");
+      return;
     }
+    MqttMessage msg;
+    msg.cmd = X_CMD_PUBLISH_COMMAND_RESULT;
+    msg.statusMessage = cloneStr(buf);
+    if (!enqueue(msg)) free(msg.statusMessage);
+  }
+
+  // can be called from any task, e.g. the command worker
+  void publishCommandResult(const char* command, const char* id, CommandResult result) {
+    StaticJsonDocument<JSON_OBJECT_SIZE(3)> doc;
+    doc["cmd"] = command;
+    doc["id"] = id;
+    doc["result"] = CommandTable::resultToString(result);
+    enqueueCommandResult(doc);
+  }
+
+  void publishCalibrationResult(const char* id, boolean success, int16_t frcCorrection) {
+    StaticJsonDocument<JSON_OBJECT_SIZE(4)> doc;
+    doc["cmd"] = "calibrate";
+    doc["id"] = id;
+    doc["result"] = CommandTable::resultToString(success ? CR_OK : CR_FAILED);
+    if (success) doc["frcCorrection"] = frcCorrection;
+    enqueueCommandResult(doc);
+  }
+
+  boolean publishCommandResultInternal(char* result) {
+    if (!publish(topics.upStatus, result)) {
+      ESP_LOGI(TAG, "publish command result failed!");
+      return false;
+    }
+    free(result);
+    return true;
   }
 
   boolean publishStatusMsgInternal(char* statusMessage, boolean keepOnFailure) {
@@ -208,8 +560,6 @@ namespace mqtt {
       free(statusMessage);
       return true;// pretend to have been successful to prevent queue from clogging up
     }
-    char topic[256];
-    sprintf(topic, "%s/%u/up/status", config.mqttTopic, config.deviceId);
     char msg[256];
     DynamicJsonDocument doc(CONFIG_SIZE);
     doc["msg"] = statusMessage;
@@ -218,7 +568,7 @@ namespace mqtt {
       free(statusMessage);
       return true;// pretend to have been successful to prevent queue from clogging up
     }
-    if (!mqtt_client->publish(topic, msg)) {
+    if (!publish(topics.upStatus, msg)) {
       ESP_LOGI(TAG, "publish status msg failed!");
       if (!keepOnFailure) free(statusMessage);
       // don't free heap, since message will be re-tried
@@ -228,232 +578,399 @@ namespace mqtt {
     return true;
   }
 
-  // Helper to write a file to fs
-  bool writeFile(const char* name, unsigned char* contents) {
-    File f;
-    if (!(f = LittleFS.open(name, FILE_WRITE))) {
+  // writes the payload in chunks straight from the PubSubClient buffer, validating the PEM on the
+  // way, and removes the file again if it was not a complete certificate
+  boolean writeCertFile(const char* name, const uint8_t* payload, unsigned int length) {
+    while (length > 0 && payload[length - 1] == 0x00) length--;
+    File f = LittleFS.open(name, FILE_WRITE);
+    if (!f) {
+      ESP_LOGW(TAG, "Could not open %s", name);
       return false;
     }
-    int len = strlen((char*)contents);
-    if (f.write(contents, len) != len) {
-      f.close();
-      return false;
+    PemValidator validator;
+    boolean written = true;
+    for (unsigned int offset = 0; offset < length && written && !validator.hasError(); offset += CERT_WRITE_CHUNK) {
+      size_t chunk = min(length - offset, (unsigned int)CERT_WRITE_CHUNK);
+      validator.update(payload + offset, chunk);
+      written = f.write(payload + offset, chunk) == chunk;
     }
     f.close();
-    return true;
+    boolean valid = validator.finish();
+    if (written && valid) return true;
+    ESP_LOGW(TAG, "%s cert, discarding %s", written ? "Invalid" : "Failed to write", name);
+    LittleFS.remove(name);
+    return false;
   }
 
-  void callback(char* topic, byte* payload, unsigned int length) {
-    char buf[256];
-    char msg[length + 1];
-    strncpy(msg, (char*)payload, length);
-    msg[length] = 0x00;
-    ESP_LOGI(TAG, "Message arrived [%s] %s", topic, msg);
+  boolean isMqttConnectionParameter(const char* id) {
+    return strcmp(id, "mqttHost") == 0
+      || strcmp(id, "mqttServerPort") == 0
+      || strcmp(id, "deviceId") == 0
+      || strcmp(id, "mqttUsername") == 0
+      || strcmp(id, "mqttPassword") == 0
+      || strcmp(id, "mqttTopic") == 0
+      || strcmp(id, "mqttUseTls") == 0
+      || strcmp(id, "mqttInsecure") == 0;
+  }
 
-    int16_t cmdIdx = -1;
-    if (config.mqttMirrorDevice) {
-      sprintf(buf, "%s/%u/up/", config.mqttMirrorTopic, config.mqttMirrorDevice);
-      if (strncmp(topic, buf, strlen(buf)) == 0) {
-        cmdIdx = strlen(buf);
+  CommandResult calibrateCommand(const CommandArgument& argument) {
+    return calibrateCo2SensorCallback((uint16_t)argument.number, argument.id);
+  }
+
+  CommandResult setTemperatureOffsetCommand(const CommandArgument& argument) {
+    return setTemperatureOffsetCallback((float)argument.number, argument.id);
+  }
+
+  CommandResult setSPS30AutoCleanIntervalCommand(const CommandArgument& argument) {
+    return setSPS30AutoCleanIntervalCallback((uint32_t)argument.number) ? CR_OK : CR_FAILED;
+  }
+
+  CommandResult cleanSPS30Command(const CommandArgument& argument) {
+    return cleanSPS30Callback() ? CR_OK : CR_FAILED;
+  }
+
+  CommandResult getConfigCommand(const CommandArgument& argument) {
+    publishConfiguration();
+    return CR_OK;
+  }
+
+  CommandResult getTelemetryCommand(const CommandArgument& argument) {
+    publishTelemetry();
+    return CR_OK;
+  }
+
+  CommandResult getTrendsCommand(const CommandArgument& argument) {
+    publishTrends();
+    return CR_OK;
+  }
+
+  CommandResult setConfigCommand(const CommandArgument& argument) {
+    DynamicJsonDocument doc(CONFIG_SIZE);
+    DeserializationError error = deserializeJson(doc, argument.payload);
+    if (error) {
+      ESP_LOGW(TAG, "Failed to parse message: %s", error.f_str());
+      return CR_INVALID;
+    }
+
+    // the mqtt task keeps reading config, changes are made to a copy and handed over in one go
+    bool rebootRequired = false;
+    Config newConfig = config;
+    Config mqttConfig = config;
+    bool mqttConfigUpdated = false;
+    for (ConfigParameterBase<Config>* configParameter : getConfigParameters()) {
+      if (isMqttConnectionParameter(configParameter->getId())) {
+        mqttConfigUpdated |= configParameter->fromJson(mqttConfig, &doc, false);
+        if (configParameter->fromJson(mqttConfig, &doc, false))
+          ESP_LOGI(TAG, "MQTT Config %s updated to %s", configParameter->getId(), configParameter->toString(mqttConfig).c_str());
+      } else {
+        rebootRequired |= (configParameter->fromJson(newConfig, &doc, false) && configParameter->isRebootRequiredOnChange());
+        if (configParameter->fromJson(newConfig, &doc, false))
+          ESP_LOGI(TAG, "Config %s updated to %s. Reboot needed? %s", configParameter->getId(), configParameter->toString(newConfig).c_str(), configParameter->isRebootRequiredOnChange() ? "true" : "false");
+      }
+    }
+    bool mqttTestSuccess = true;
+
+    if (mqttConfigUpdated) {
+      Client* testWifiClient;
+      TlsCredentials* testCredentials = NULL;
+      if (mqttConfig.mqttUseTls) {
+        // parsed again for the test, the key and certs of the live connection belong to the mqtt task
+        testCredentials = new TlsCredentials();
+        if (!testCredentials->load(MQTT_ROOT_CA_FILENAME, MQTT_CLIENT_KEY_FILENAME, MQTT_CLIENT_CERT_FILENAME))
+          ESP_LOGW(TAG, "Failed to load MQTT credentials for the test");
+        testWifiClient = new TlsClient(testCredentials, mqttConfig.mqttInsecure);
+      } else {
+        testWifiClient = new WiFiClient();
       }
-      if (cmdIdx >= 0) {
-        strncpy(buf, topic + cmdIdx, strlen(topic) - cmdIdx + 1);
-        if (strncmp(buf, "sensors", strlen(buf)) == 0) {
-          DynamicJsonDocument doc(512);
-          DeserializationError error = deserializeJson(doc, msg);
-          if (error) {
-            ESP_LOGW(TAG, "Failed to parse message: %s", error.f_str());
-            return;
-          }
-          if (doc.containsKey("co2")) {
-            model->updateModel(doc["co2"].as<uint16_t>());
-          }
+      mqttTestSuccess = testMqttConfig(testWifiClient, mqttConfig);
+      delete testWifiClient;
+      delete testCredentials;
+      if (mqttTestSuccess) {
+        for (ConfigParameterBase<Config>* configParameter : getConfigParameters()) {
+          if (isMqttConnectionParameter(configParameter->getId())) configParameter->fromJson(newConfig, &doc, false);
         }
+        rebootRequired = true;
       }
     }
-    sprintf(buf, "%s/%u/down/", config.mqttTopic, config.deviceId);
-    if (strncmp(topic, buf, strlen(buf)) == 0) {
-      ESP_LOGI(TAG, "Device specific downlink message arrived [%s]", topic);
-      cmdIdx = strlen(buf);
+    if (saveConfiguration(newConfig) && rebootRequired) {
+      // the mqtt task publishes the message in the meantime
+      publishStatusMsg("configuration updated - rebooting shortly");
+      delay(2000);
+      esp_restart();
     }
-    sprintf(buf, "%s/down/", config.mqttTopic);
-    if (strncmp(topic, buf, strlen(buf)) == 0) {
-      ESP_LOGI(TAG, "Device agnostic downlink message arrived [%s]", topic);
-      cmdIdx = strlen(buf);
+    MqttMessage msg;
+    msg.cmd = X_CMD_APPLY_CONFIG;
+    msg.statusMessage = nullptr;
+    msg.config = new Config(newConfig);
+    if (!enqueue(msg)) {
+      ESP_LOGW(TAG, "Configuration saved but not applied");
+      delete msg.config;
+      return CR_BUSY;
     }
-    if (cmdIdx < 0) return;
-    strncpy(buf, topic + cmdIdx, strlen(topic) - cmdIdx + 1);
-    ESP_LOGI(TAG, "Received command [%s]", buf);
-
-    if (strncmp(buf, "calibrate", strlen(buf)) == 0) {
-      int reference = atoi(msg);
-      if (reference >= 400 && reference <= 2000) {
-        calibrateCo2SensorCallback(reference);
-      }
-    } else if (strncmp(buf, "setTemperatureOffset", strlen(buf)) == 0) {
-      float tempOffset = atof(msg);
-      if (0.0 <= tempOffset && tempOffset <= 10.0) {
-        setTemperatureOffsetCallback(tempOffset);
-      }
-    } else if (strncmp(buf, "setSPS30AutoCleanInterval", strlen(buf)) == 0) {
-      char* eptr;
-      long interval = std::strtoul(msg, &eptr, 10);
-      setSPS30AutoCleanIntervalCallback(interval);
-    } else if (strncmp(buf, "cleanSPS30", strlen(buf)) == 0) {
-      cleanSPS30Callback();
-    } else if (strncmp(buf, "getConfig", strlen(buf)) == 0) {
-      publishConfiguration();
-    } else if (strncmp(buf, "setConfig", strlen(buf)) == 0) {
-      DynamicJsonDocument doc(CONFIG_SIZE);
-      DeserializationError error = deserializeJson(doc, msg);
-      if (error) {
-        ESP_LOGW(TAG, "Failed to parse message: %s", error.f_str());
-        return;
-      }
+    return mqttTestSuccess ? CR_OK : CR_FAILED;
+  }
 
-      bool rebootRequired = false;
-      Config mqttConfig = config;
-      bool mqttConfigUpdated = false;
-      for (ConfigParameterBase<Config>* configParameter : getConfigParameters()) {
-        if (strncmp(configParameter->getId(), "mqttHost", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "mqttServerPort", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "deviceId", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "mqttUsername", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "mqttPassword", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "mqttTopic", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "mqttUseTls", strlen(buf)) == 0
-          || strncmp(configParameter->getId(), "mqttInsecure", strlen(buf)) == 0) {
-          mqttConfigUpdated |= configParameter->fromJson(mqttConfig, &doc, false);
-          if (configParameter->fromJson(mqttConfig, &doc, false))
-            ESP_LOGI(TAG, "MQTT Config %s updated to %s", configParameter->getId(), configParameter->toString(mqttConfig).c_str());
-        } else {
-          rebootRequired |= (configParameter->fromJson(config, &doc, false) && configParameter->isRebootRequiredOnChange());
-          if (configParameter->fromJson(config, &doc, false))
-            ESP_LOGI(TAG, "Config %s updated to %s. Reboot needed? %s", configParameter->getId(), configParameter->toString(config).c_str(), configParameter->isRebootRequiredOnChange() ? "true" : "false");
-        }
-      }
-      bool mqttTestSuccess = true;
-
-      if (mqttConfigUpdated) {
-        WiFiClient* testWifiClient;
-        if (mqttConfig.mqttUseTls) {
-          testWifiClient = new WiFiClientSecure();
-          if (mqttConfig.mqttInsecure) {
-            ((WiFiClientSecure*)testWifiClient)->setInsecure();
-          }
-          setMqttCerts((WiFiClientSecure*)testWifiClient, MQTT_ROOT_CA_FILENAME, MQTT_CLIENT_KEY_FILENAME, MQTT_CLIENT_CERT_FILENAME);
-        } else {
-          testWifiClient = new WiFiClient();
-        }
-        mqttTestSuccess = testMqttConfig(testWifiClient, mqttConfig);
+  // runs on the command worker once the new cert has been written
+  CommandResult activateMqttRootCaCommand(const CommandArgument& argument) {
+    bool mqttTestSuccess = config.mqttInsecure || !config.mqttUseTls; // no need to test if not using tls, or not checking certs
+    if (config.mqttUseTls && !config.mqttInsecure) {
+      ESP_LOGD(TAG, "test connection using new ca");
+      // test connection using cert
+      TlsCredentials* testCredentials = new TlsCredentials();
+      if (testCredentials->load(TEMP_MQTT_ROOT_CA_FILENAME, MQTT_CLIENT_KEY_FILENAME, MQTT_CLIENT_CERT_FILENAME)) {
+        TlsClient* testWifiClient = new TlsClient(testCredentials, false);
+        mqttTestSuccess = testMqttConfig(testWifiClient, config);
         delete testWifiClient;
-        if (mqttTestSuccess) {
-          config = mqttConfig;
-          rebootRequired = true;
-        }
       }
-      if (saveConfiguration(config) && rebootRequired) {
-        publishStatusMsgInternal(cloneStr("configuration updated - rebooting shortly"), false);
+      delete testCredentials;
+    }
+    ESP_LOGD(TAG, "mqttTestSuccess %u", mqttTestSuccess);
+    if (mqttTestSuccess) {
+      if (LittleFS.exists(MQTT_ROOT_CA_FILENAME) && !LittleFS.remove(MQTT_ROOT_CA_FILENAME)) {
+        ESP_LOGE(TAG, "Failed to remove original CA file");
+        publishStatusMsg("Could not remove original CA - giving up");
+        return CR_FAILED;  // leave old file in place and give up.
+      }
+      if (!LittleFS.rename(TEMP_MQTT_ROOT_CA_FILENAME, MQTT_ROOT_CA_FILENAME)) {
+        publishStatusMsg("Could not replace original CA with new CA - PANIC - giving up");
+        ESP_LOGE(TAG, "Failed to move temporary CA file");
+        Config insecureConfig = config;
+        insecureConfig.mqttInsecure = true;
+        saveConfiguration(insecureConfig);
         delay(2000);
         esp_restart();
+        return CR_FAILED;
       }
-      configChangedCallback();
-    } else if (strncmp(buf, "installMqttRootCa", strlen(buf)) == 0) {
-      ESP_LOGD(TAG, "installMqttRootCa");
-      if (!writeFile(TEMP_MQTT_ROOT_CA_FILENAME, (unsigned char*)&msg[0])) {
-        ESP_LOGW(TAG, "Error writing mqtt root ca");
-        publishStatusMsgInternal(cloneStr("Error writing cert to FS"), false);
-        return;
-      }
-      bool mqttTestSuccess = config.mqttInsecure || !config.mqttUseTls; // no need to test if not using tls, or not checking certs
-      if (config.mqttUseTls && !config.mqttInsecure) {
-        ESP_LOGD(TAG, "test connection using new ca");
-        // test connection using cert
-        WiFiClientSecure* testWifiClient = new WiFiClientSecure();
-        setMqttCerts(testWifiClient, TEMP_MQTT_ROOT_CA_FILENAME, MQTT_CLIENT_KEY_FILENAME, MQTT_CLIENT_CERT_FILENAME);
-        mqttTestSuccess = testMqttConfig(testWifiClient, config);
-        delete testWifiClient;
-      }
-      ESP_LOGD(TAG, "mqttTestSuccess %u", mqttTestSuccess);
-      if (mqttTestSuccess) {
-        if (LittleFS.exists(MQTT_ROOT_CA_FILENAME) && !LittleFS.remove(MQTT_ROOT_CA_FILENAME)) {
-          ESP_LOGE(TAG, "Failed to remove original CA file");
-          publishStatusMsgInternal(cloneStr("Could not remove original CA - giving up"), false);
-          return;  // leave old file in place and give up.
-        }
-        if (!LittleFS.rename(TEMP_MQTT_ROOT_CA_FILENAME, MQTT_ROOT_CA_FILENAME)) {
-          publishStatusMsgInternal(cloneStr("Could not replace original CA with new CA - PANIC - giving up"), false);
-          ESP_LOGE(TAG, "Failed to move temporary CA file");
-          config.mqttInsecure = true;
-          saveConfiguration(config);
-          delay(2000);
-          esp_restart();
+      ESP_LOGI(TAG, "installed and tested new CA, rebooting shortly");
+      publishStatusMsg("installed and tested new CA - rebooting shortly");
+      delay(2000);
+      esp_restart();
+      return CR_OK;
+    }
+    ESP_LOGI(TAG, "publish connect msg failed!");
+    publishStatusMsg("Connecting using the new CA failed - reverting");
+    if (!LittleFS.remove(TEMP_MQTT_ROOT_CA_FILENAME)) ESP_LOGW(TAG, "Failed to remove temporary CA file");
+    return CR_FAILED;
+  }
+
+  const Command ACTIVATE_MQTT_ROOT_CA = { "installMqttRootCa", CA_NONE, 0, 0, activateMqttRootCaCommand, CE_WORKER };
+
+  // streams the cert to a temporary file right away, the payload is only valid during the callback,
+  // and leaves the connection test to the command worker
+  CommandResult installMqttRootCaCommand(const CommandArgument& argument) {
+    ESP_LOGD(TAG, "installMqttRootCa");
+    if (!writeCertFile(TEMP_MQTT_ROOT_CA_FILENAME, (const uint8_t*)argument.payload, argument.length)) return CR_FAILED;
+    if (!CommandWorker::submit(&ACTIVATE_MQTT_ROOT_CA, argument.id, NULL, 0)) {
+      if (!LittleFS.remove(TEMP_MQTT_ROOT_CA_FILENAME)) ESP_LOGW(TAG, "Failed to remove temporary CA file");
+      return CR_BUSY;
+    }
+    return CR_QUEUED;
+  }
+
+  CommandResult installRootCaCommand(const CommandArgument& argument) {
+    ESP_LOGD(TAG, "installRootCa");
+    if (!writeCertFile(TEMP_ROOT_CA_FILENAME, (const uint8_t*)argument.payload, argument.length)) return CR_FAILED;
+    // only replace the current cert once the new one is complete
+    if ((LittleFS.exists(ROOT_CA_FILENAME) && !LittleFS.remove(ROOT_CA_FILENAME)) || !LittleFS.rename(TEMP_ROOT_CA_FILENAME, ROOT_CA_FILENAME)) {
+      ESP_LOGW(TAG, "Failed to replace root ca");
+      return CR_FAILED;
+    }
+    return CR_OK;
+  }
+
+  CommandResult resetWifiCommand(const CommandArgument& argument) {
+    WifiManager::resetSettings();
+    return CR_OK;
+  }
+
+  CommandResult otaCommand(const CommandArgument& argument) {
+    OTA::checkForUpdate();
+    return CR_OK;
+  }
+
+  CommandResult forceOtaCommand(const CommandArgument& argument) {
+    OTA::forceUpdate(argument.payload);
+    return CR_OK;
+  }
+
+  CommandResult rebootCommand(const CommandArgument& argument) {
+    esp_restart();
+    return CR_OK;
+  }
+
+  void callback(char* topic, byte* payload, unsigned int length) {
+    ESP_LOGI(TAG, "Message arrived [%s] %u bytes", topic, length);
+    connectionStats.bytesReceived += strlen(topic) + length;
+
+    int16_t cmdIdx = -1;
+    if (config.mqttMirrorDevice && strncmp(topic, topics.mirrorUp, topics.mirrorUpLen) == 0) {
+      boolean isJson = strcmp(topic, topics.mirrorSensors) == 0;
+      if (isJson || strcmp(topic, topics.mirrorSensorsMsgPack) == 0) {
+        DynamicJsonDocument doc(SENSORS_BATCH_MAX * 256);
+        DeserializationError error = isJson ? deserializeJson(doc, payload, length) : deserializeMsgPack(doc, payload, length);
+        if (error) {
+          ESP_LOGW(TAG, "Failed to parse message: %s", error.f_str());
           return;
         }
-        ESP_LOGI(TAG, "installed and tested new CA, rebooting shortly");
-        publishStatusMsgInternal(cloneStr("installed and tested new CA - rebooting shortly"), false);
-        delay(2000);
-        esp_restart();
-      } else {
-        ESP_LOGI(TAG, "publish connect msg failed!");
-        publishStatusMsgInternal(cloneStr("Connecting using the new CA failed - reverting"), false);
-        if (!LittleFS.remove(TEMP_MQTT_ROOT_CA_FILENAME)) ESP_LOGW(TAG, "Failed to remove temporary CA file");
+        // batched readings arrive as array, the most recent one last
+        JsonObject reading = doc.is<JsonArray>() ? doc[doc.size() - 1].as<JsonObject>() : doc.as<JsonObject>();
+        if (reading.containsKey("co2")) {
+          model->updateModel(reading["co2"].as<uint16_t>());
+        }
       }
-    } else if (strncmp(buf, "installRootCa", strlen(buf)) == 0) {
-      ESP_LOGD(TAG, "installRootCa");
-      if (!writeFile(ROOT_CA_FILENAME, (unsigned char*)&msg[0])) {
-        ESP_LOGW(TAG, "Error writing root ca");
-        publishStatusMsgInternal(cloneStr("Error writing cert to FS"), false);
+      return;
+    }
+    if (strncmp(topic, topics.downDevice, topics.downDeviceLen) == 0) {
+      ESP_LOGI(TAG, "Device specific downlink message arrived [%s]", topic);
+      cmdIdx = topics.downDeviceLen;
+    } else if (strncmp(topic, topics.downAll, topics.downAllLen) == 0) {
+      ESP_LOGI(TAG, "Device agnostic downlink message arrived [%s]", topic);
+      cmdIdx = topics.downAllLen;
+    }
+    if (cmdIdx < 0) return;
+    // down/<command> or down/<command>/<correlation id>
+    char command[COMMAND_NAME_LEN + 1];
+    char id[COMMAND_ID_LEN + 1];
+    const char* separator = strchr(topic + cmdIdx, '/');
+    size_t commandLen = separator ? separator - (topic + cmdIdx) : strlen(topic + cmdIdx);
+    if (commandLen > COMMAND_NAME_LEN) commandLen = COMMAND_NAME_LEN;
+    memcpy(command, topic + cmdIdx, commandLen);
+    command[commandLen] = 0x00;
+    if (separator && separator[1] != 0x00) {
+      strncpy(id, separator + 1, COMMAND_ID_LEN);
+      id[COMMAND_ID_LEN] = 0x00;
+    } else {
+      snprintf(id, sizeof(id), "%u", ++commandSequence);
+    }
+    ESP_LOGI(TAG, "Received command [%s] id [%s]", command, id);
+
+    const Command* cmd = CommandTable::find(COMMANDS, COMMAND_COUNT, command);
+    CommandResult result;
+    if (!cmd) {
+      result = CR_UNKNOWN;
+    } else if (cmd->execution == CE_WORKER) {
+      char* copy = length < CONFIG_SIZE ? (char*)malloc(length + 1) : NULL;
+      if (length >= CONFIG_SIZE) {
+        result = CR_TOO_LONG;
+      } else if (!copy) {
+        result = CR_BUSY;
+      } else {
+        memcpy(copy, payload, length);
+        copy[length] = 0x00;
+        result = CommandWorker::submit(cmd, id, copy, length) ? CR_QUEUED : CR_BUSY;
       }
-    } else if (strncmp(buf, "resetWifi", strlen(buf)) == 0) {
-      WifiManager::resetSettings();
-    } else if (strncmp(buf, "ota", strlen(buf)) == 0) {
-      OTA::checkForUpdate();
-    } else if (strncmp(buf, "forceota", strlen(buf)) == 0) {
-      OTA::forceUpdate(msg);
-    } else if (strncmp(buf, "reboot", strlen(buf)) == 0) {
-      esp_restart();
+    } else if (cmd->argType == CA_RAW) {
+      result = CommandTable::execute(cmd, (const char*)payload, length, id);
+    } else if (length >= sizeof(commandPayload)) {
+      result = CR_TOO_LONG;
+    } else {
+      memcpy(commandPayload, payload, length);
+      commandPayload[length] = 0x00;
+      result = CommandTable::execute(cmd, commandPayload, length, id);
+    }
+    if (result != CR_OK && result != CR_QUEUED) ESP_LOGW(TAG, "Command [%s] rejected: %s", command, CommandTable::resultToString(result));
+    publishCommandResult(command, id, result);
+  }
+
+  void scheduleReconnect() {
+    uint32_t delay = reconnectBackoff.nextDelay(esp_random());
+    nextReconnectAttempt = millis() + delay;
+    ESP_LOGD(TAG, "Next MQTT connection attempt in %u ms", delay);
+  }
+
+  // notices a lost connection, the first attempt is already jittered as the whole fleet loses it at once
+  void checkConnection() {
+    boolean connected = mqtt_client->connected();
+    if (wasConnected && !connected) {
+      ESP_LOGW(TAG, "MQTT connection lost, rc=%i", mqtt_client->state());
+      disconnectedSince = millis();
+      connectionStats.disconnects++;
+      connectionStats.connectedMs += disconnectedSince - connectedSince;
+      scheduleReconnect();
     }
+    wasConnected = connected;
   }
 
   void reconnect() {
-    if (!WiFi.isConnected() || mqtt_client->connected() || shutdownInProgress) return;
-    if (millis() - lastReconnectAttempt < 60000) return;
-    if (strncmp(config.mqttHost, "127.0.0.1", MQTT_HOSTNAME_LEN) == 0 ||
-      strncmp(config.mqttHost, "localhost", MQTT_HOSTNAME_LEN) == 0) return;
-    char topic[256];
+    if (!WiFi.isConnected() || mqtt_client->connected() || shutdownInProgress || connectionTestRunning) return;
+    if (!isMqttHostConfigured()) return;
+    if (ipAcquired) {
+      // fast path, the broker was most likely just unreachable from here
+      ipAcquired = false;
+      reconnectBackoff.reset();
+      nextReconnectAttempt = millis();
+    }
+    if ((int32_t)(millis() - nextReconnectAttempt) < 0) return;
     char id[64];
     sprintf(id, "%s-%u-%s", appName, config.deviceId, WifiManager::getMac().c_str());
-    lastReconnectAttempt = millis();
     ESP_LOGD(TAG, "Attempting MQTT connection...");
     connectionAttempts++;
-    sprintf(topic, "%s/%u/up/status", config.mqttTopic, config.deviceId);
-    if (mqtt_client->connect(id, config.mqttUsername, config.mqttPassword, topic, 1, false, "{\"msg\":\"disconnected\"}")) {
-      ESP_LOGD(TAG, "MQTT connected");
-      sprintf(topic, "%s/%u/down/#", config.mqttTopic, config.deviceId);
-      mqtt_client->subscribe(topic);
-      sprintf(topic, "%s/down/#", config.mqttTopic);
-      mqtt_client->subscribe(topic);
+    uint32_t start = millis();
+    if (mqtt_client->connect(id, config.mqttUsername, config.mqttPassword, topics.upStatus, 1, false, "{\"msg\":\"disconnected\"}")) {
+      uint32_t connectDuration = millis() - start;
+      uint32_t reconnectDuration = millis() - disconnectedSince;
+      wasConnected = true;
+      connectedSince = millis();
+      connectionStats.connects++;
+      connectionStats.lastReconnectMs = reconnectDuration;
+      connectionStats.maxReconnectMs = max(connectionStats.maxReconnectMs, reconnectDuration);
+      ESP_LOGI(TAG, "MQTT connected after %u attempt(s) in %u ms, connect took %u ms", reconnectBackoff.getFailures() + 1, reconnectDuration, connectDuration);
+      reconnectBackoff.reset();
+      mqtt_client->subscribe(topics.subscribeDevice);
+      mqtt_client->subscribe(topics.subscribeAll);
       if (config.mqttMirrorDevice) {
-        sprintf(topic, "%s/%u/up/sensors", config.mqttMirrorTopic, config.mqttMirrordeviceId);
-        mqtt_client->subscribe(topic);
+        mqtt_client->subscribe(topics.mirrorSensors);
+        mqtt_client->subscribe(topics.mirrorSensorsMsgPack);
       }
-      sprintf(topic, "%s/%u/up/status", config.mqttTopic, config.deviceId);
+      lastPacketIn = lastPacketOut = millis();
       char msg[256];
       DynamicJsonDocument doc(CONFIG_SIZE);
       doc["online"] = true;
       doc["connectionAttempts"] = connectionAttempts;
+      doc["reconnectMs"] = reconnectDuration;
+      doc["connectMs"] = connectDuration;
+      if (wifiClientTls) {
+        doc["tlsHandshakeMs"] = ((TlsClient*)wifiClient)->getHandshakeMs();
+        doc["tlsResumed"] = ((TlsClient*)wifiClient)->isResumed();
+      }
       if (serializeJson(doc, msg) == 0) {
         ESP_LOGW(TAG, "Failed to serialise payload");
         return;
       }
-      if (mqtt_client->publish(topic, msg))
+      if (publish(topics.upStatus, msg))
         connectionAttempts = 0;
       else
         ESP_LOGI(TAG, "publish connect msg failed!");
     } else {
       ESP_LOGW(TAG, "MQTT connection failed, rc=%i", mqtt_client->state());
-      vTaskDelay(pdMS_TO_TICKS(1000));
+      scheduleReconnect();
+    }
+  }
+
+  void eventHandler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+      ipAcquired = true;
+      if (mqttTask) xTaskNotify(mqttTask, X_NOTIFY_WORK, eSetBits);
+    }
+  }
+
+  // select() on the socket handed over by watchSocket() until it is readable, closing it wakes the
+  // select up as well. The timeout only guards against missing that.
+  void socketWatchLoop(void* pvParameters) {
+    while (1) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      while (socketWatchArmed && watchedSocket >= 0) {
+        int socket = watchedSocket;
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(socket, &readSet);
+        struct timeval timeout = { MQTT_KEEPALIVE_S, 0 };
+        int ready = select(socket + 1, &readSet, NULL, NULL, &timeout);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+        socketWatchArmed = false;
+        // a failed select leaves it to the mqtt task to arm the watch again
+        if (ready > 0 && !shutdownInProgress) xTaskNotify(mqttTask, X_NOTIFY_SOCKET, eSetBits);
+      }
     }
   }
 
@@ -474,10 +991,16 @@ namespace mqtt {
     configChangedCallback_t _configChangedCallback
   ) {
     appName = _appName;
+    model = _model;
+    buildTopics();
+    reconnectBackoff = configuredBackoff();
+    offlineStore = new SampleStore(&LittleFS, OFFLINE_STORE_FILENAME, OFFLINE_STORE_PAGES);
+    offlineStore->begin();
     mqttQueue = xQueueCreate(MQTT_QUEUE_LENGTH, sizeof(struct MqttMessage));
     if (mqttQueue == NULL) {
       ESP_LOGE(TAG, "Queue creation failed!");
     }
+    disconnected = xSemaphoreCreateBinary();
 
     calibrateCo2SensorCallback = _calibrateCo2SensorCallback;
     setTemperatureOffsetCallback = _setTemperatureOffsetCallback;
@@ -487,13 +1010,16 @@ namespace mqtt {
     cleanSPS30Callback = _cleanSPS30Callback;
     getSPS30StatusCallback = _getSPS30StatusCallback;
     configChangedCallback = _configChangedCallback;
+    // connection tests run TLS handshakes on the worker
+    if (!CommandWorker::setup(publishCommandResult, 8192, 1, 1)) ESP_LOGE(TAG, "Command worker creation failed!");
 
     if (config.mqttUseTls) {
-      wifiClient = new WiFiClientSecure();
-      if (config.mqttInsecure) {
-        ((WiFiClientSecure*)wifiClient)->setInsecure();
-      }
-      setMqttCerts((WiFiClientSecure*)wifiClient, MQTT_ROOT_CA_FILENAME, MQTT_CLIENT_KEY_FILENAME, MQTT_CLIENT_CERT_FILENAME);
+      // parsed once and only used by the mqtt task, a changed root ca or client cert takes effect after a reboot
+      mqttCredentials = new TlsCredentials();
+      if (!mqttCredentials->load(MQTT_ROOT_CA_FILENAME, MQTT_CLIENT_KEY_FILENAME, MQTT_CLIENT_CERT_FILENAME))
+        ESP_LOGW(TAG, "Failed to load MQTT credentials");
+      wifiClient = new TlsClient(mqttCredentials, config.mqttInsecure);
+      wifiClientTls = true;
     } else {
       wifiClient = new WiFiClient();
     }
@@ -502,6 +1028,9 @@ namespace mqtt {
     mqtt_client->setServer(config.mqttHost, config.mqttServerPort);
     mqtt_client->setCallback(callback);
     if (!mqtt_client->setBufferSize(MQTT_BUFFER_SIZE)) ESP_LOGE(TAG, "mqtt_client->setBufferSize failed!");
+    mqtt_client->setKeepAlive(MQTT_KEEPALIVE_S);
+    if (xTaskCreatePinnedToCore(socketWatchLoop, "mqttSocket", 2048, NULL, 2, &socketWatchTask, 0) != pdPASS)
+      ESP_LOGE(TAG, "Socket watch task creation failed!");
 
     //    logging::addOnLogCallback(logCallback);
   }
@@ -511,20 +1040,17 @@ namespace mqtt {
     if (mqttQueue) {
       MqttMessage msg;
       msg.cmd = X_CMD_SHUTDOWN;
-      xQueueSendToFront(mqttQueue, (void*)&msg, pdMS_TO_TICKS(100));
-      while (!shutdownInProgress) {
+      msg.statusMessage = nullptr;
+      enqueue(msg, true);
+      while (!mqttTaskParked) {
         vTaskDelay(pdMS_TO_TICKS(50));
       }
       mqttQueue = NULL;
     }
     if (mqtt_client && mqtt_client->connected()) {
-      char buf[256];
-      sprintf(buf, "%s/%u/up/status", config.mqttTopic, config.deviceId);
-      mqtt_client->publish(buf, "{\"online\":false}");
-      sprintf(buf, "%s/%u/down/#", config.mqttTopic, config.deviceId);
-      mqtt_client->unsubscribe(buf);
-      sprintf(buf, "%s/down/#", config.mqttTopic);
-      mqtt_client->unsubscribe(buf);
+      publish(topics.upStatus, "{\"online\":false}");
+      mqtt_client->unsubscribe(topics.subscribeDevice);
+      mqtt_client->unsubscribe(topics.subscribeAll);
       mqtt_client->disconnect();
     }
     if (mqttTask) {
@@ -533,41 +1059,172 @@ namespace mqtt {
     ESP_LOGD(TAG, "done");
   }
 
+  uint32_t msUntil(uint32_t deadline, uint32_t now) {
+    int32_t remaining = (int32_t)(deadline - now);
+    return remaining > 0 ? remaining : 0;
+  }
+
+  // PubSubClient sends a ping, or gives up on an unanswered one, once this has passed
+  uint32_t keepaliveDeadline() {
+    uint32_t last = (int32_t)(lastPacketIn - lastPacketOut) < 0 ? lastPacketIn : lastPacketOut;
+    return last + MQTT_KEEPALIVE_S * 1000UL + 1;
+  }
+
+  int clientSocket() {
+    if (!mqtt_client->connected()) return -1;
+    return wifiClientTls ? ((TlsClient*)wifiClient)->fd() : ((WiFiClient*)wifiClient)->fd();
+  }
+
+  // hands the connection's socket to the watch task unless it waits on it already
+  void watchSocket() {
+    int socket = clientSocket();
+    if (socket < 0 || (socketWatchArmed && watchedSocket == socket)) return;
+    watchedSocket = socket;
+    socketWatchArmed = true;
+    if (socketWatchTask) xTaskNotifyGive(socketWatchTask);
+  }
+
+  // calls PubSubClient's loop(), which reads at most one packet and pings when the keepalive is due
+  void serviceConnection() {
+    if (!mqtt_client->connected()) return;
+    boolean keepaliveDue = msUntil(keepaliveDeadline(), millis()) == 0;
+    boolean received = wifiClient->available() > 0;
+    mqtt_client->loop();
+    if (received) lastPacketIn = millis();
+    if (keepaliveDue) lastPacketIn = lastPacketOut = millis();
+  }
+
+  // once shutting down mqtt_client belongs to shutDownMqtt(), the task blocks until it is deleted
+  void park() {
+    portENTER_CRITICAL(&schedulerMux);
+    sensorSlotPending = false;
+    portEXIT_CRITICAL(&schedulerMux);
+    mqttTaskParked = true;
+    while (1) vTaskDelay(portMAX_DELAY);
+  }
+
+  // how long the mqtt task may sleep on its queue before the next periodic duty is due
+  uint32_t nextWakeupMs() {
+    uint32_t now = millis();
+    if (!mqtt_client->connected()) {
+      uint32_t wait = msUntil(nextReconnectAttempt, now);
+      // reconnect() skips the attempt while WiFi is down, don't spin on an overdue deadline
+      return wait > 0 ? wait : MQTT_RETRY_MS;
+    }
+    // mbedTLS may hold records that were read from the socket already
+    if (wifiClient->available() > 0) return 0;
+    uint32_t wait = msUntil(keepaliveDeadline(), now);
+    if (batchCount > 0) wait = min(wait, config.sensorsBatchSize <= 1 ? 0 : msUntil(batch[0].timestamp + config.sensorsBatchInterval * 1000UL, now));
+    if (offlineStore->size() > 0) wait = min(wait, msUntil(lastReplay + OFFLINE_REPLAY_INTERVAL_MS, now));
+    return min(wait, msUntil(lastMetrics + METRICS_INTERVAL_MS, now));
+  }
+
+  // true if the message has been dealt with and can be removed from the queue
+  boolean handleMessage(MqttMessage& msg) {
+    if (msg.cmd == X_CMD_SHUTDOWN) {
+      shutdownInProgress = true;
+      return false;
+    }
+    if (msg.cmd == X_CMD_CONFIG_CHANGED) {
+      buildTopics();
+      reconnectBackoff = configuredBackoff();
+      return true;
+    }
+    if (msg.cmd == X_CMD_APPLY_CONFIG) {
+      config = *msg.config;
+      delete msg.config;
+      configChangedCallback();
+      return true;
+    }
+    if (msg.cmd == X_CMD_DISCONNECT) {
+      // checkConnection() accounts for it like for any lost connection
+      if (mqtt_client->connected()) mqtt_client->disconnect();
+      xSemaphoreGive(disconnected);
+      return true;
+    }
+    if (!mqtt_client->connected()) return false;
+    if (msg.cmd == X_CMD_PUBLISH_CONFIGURATION) return publishConfigurationInternal();
+    // keep status messages in the queue should they fail to be published
+    if (msg.cmd == X_CMD_PUBLISH_STATUS_MSG) return publishStatusMsgInternal(msg.statusMessage, true);
+    if (msg.cmd == X_CMD_PUBLISH_COMMAND_RESULT) return publishCommandResultInternal(msg.statusMessage);
+    if (msg.cmd == X_CMD_PUBLISH_TELEMETRY) return publishTelemetryInternal();
+    if (msg.cmd == X_CMD_PUBLISH_TRENDS) return publishTrendsInternal();
+    return true;
+  }
+
+  void handleSensorSample(const SensorSample& sample, uint32_t queued) {
+    if (!mqtt_client->connected()) {
+      // keep measurements while offline, they are replayed once reconnected
+      storeOffline(sample);
+      return;
+    }
+    Latency::recordSince(LS_MQTT_QUEUE, queued);
+    if (config.sensorsBatchSize > 1) {
+      addToBatch(sample);
+    } else if (!publishSensorsInternal(sample)) {
+      storeOffline(sample);
+    }
+  }
+
+  uint32_t getLoopWakeups() {
+    return loopWakeups;
+  }
+
+  /**
+   * Two classes of traffic: control messages (status, config, command results) in a FIFO and
+   * sensor data in a latest value wins slot. The control queue is always served first, the slot
+   * only once the queue is empty or its head can't be sent right now. Producers notify the task,
+   * which otherwise sleeps until the next duty is due. While connected the socket watch task
+   * notifies it when the broker sent something, and the keepalive deadline is one of the duties,
+   * so an idle connection costs one wakeup per MQTT_KEEPALIVE_S. Records mbedTLS has read from the
+   * socket already are drained before sleeping. A message left at the head of the queue (publish
+   * failed, offline) is retried after MQTT_RETRY_MS rather than straight away.
+   */
   void mqttLoop(void* pvParameters) {
-    _ASSERT((uint32_t)pvParameters == 1);
-    lastReconnectAttempt = millis() - 60000;
-    BaseType_t notified;
+    _ASSERT((uintptr_t)pvParameters == 1);
+    disconnectedSince = millis();
+    nextReconnectAttempt = millis();
+    boolean headPending = false;
+    uint32_t notified;
     MqttMessage msg;
+    SensorSample sample;
+    uint32_t queued;
     while (1) {
-      if (mqttQueue && !shutdownInProgress) {
-        notified = xQueuePeek(mqttQueue, &msg, pdMS_TO_TICKS(100));
-        if (notified == pdPASS && !shutdownInProgress) {
-          if (mqtt_client->connected()) {
-            if (msg.cmd == X_CMD_PUBLISH_CONFIGURATION) {
-              if (publishConfigurationInternal()) {
-                xQueueReceive(mqttQueue, &msg, pdMS_TO_TICKS(100));
-              }
-            } else if (msg.cmd == X_CMD_PUBLISH_SENSORS) {
-              // don't keep measurements in the queue should they fail to be published
-              publishSensorsInternal(msg);
-              xQueueReceive(mqttQueue, &msg, pdMS_TO_TICKS(100));
-            } else if (msg.cmd == X_CMD_PUBLISH_STATUS_MSG) {
-              // keep status messages in the queue should they fail to be published
-              if (publishStatusMsgInternal(msg.statusMessage, true)) {
-                xQueueReceive(mqttQueue, &msg, pdMS_TO_TICKS(100));
-              }
-            }
-          }
-          if (msg.cmd == X_CMD_SHUTDOWN) {
-            shutdownInProgress = true;
-          }
+      boolean controlWaiting = mqttQueue && !headPending && uxQueueMessagesWaiting(mqttQueue) > 0;
+      if (!controlWaiting && !sensorSlotPending) {
+        uint32_t wait = nextWakeupMs();
+        watchSocket();
+        xTaskNotifyWait(0x00, ULONG_MAX, &notified, pdMS_TO_TICKS(headPending ? max(wait, (uint32_t)MQTT_RETRY_MS) : wait));
+        loopWakeups++;
+      }
+      headPending = false;
+      if (mqttQueue && xQueuePeek(mqttQueue, &msg, 0) == pdPASS) {
+        if (handleMessage(msg)) {
+          xQueueReceive(mqttQueue, &msg, 0);
+        } else {
+          headPending = true;
+        }
+      }
+      if (shutdownInProgress) park();
+      if ((headPending || !mqttQueue || uxQueueMessagesWaiting(mqttQueue) == 0) && takeSensorSlot(sample, queued)) {
+        handleSensorSample(sample, queued);
+      }
+      if (batchCount > 0 && mqtt_client->connected()
+        && (config.sensorsBatchSize <= 1 || millis() - batch[0].timestamp >= config.sensorsBatchInterval * 1000UL)) {
+        publishBatchInternal();
+      }
+      if (mqtt_client->connected()) {
+        replayOffline();
+        if (millis() - lastMetrics >= METRICS_INTERVAL_MS) {
+          publishMetricsInternal();
+          publishTelemetryInternal();
         }
       }
-      if (!mqtt_client->connected() && !shutdownInProgress) {
+      checkConnection();
+      if (!mqtt_client->connected()) {
         reconnect();
       }
-      mqtt_client->loop();
-      vTaskDelay(pdMS_TO_TICKS(50));
+      serviceConnection();
     }
     vTaskDelete(NULL);
   }
@@ -0,0 +1,27 @@
+#include <mqttCommands.h>
+
+namespace mqtt {
+
+  // sorted by name, one entry per command, CE_WORKER for anything that can block for more than a few ms
+  constexpr Command COMMAND_TABLE[] = {
+    { "calibrate", CA_INT, 400, 2000, calibrateCommand, CE_WORKER },
+    { "cleanSPS30", CA_NONE, 0, 0, cleanSPS30Command, CE_WORKER },
+    { "forceota", CA_PAYLOAD, 0, 0, forceOtaCommand, CE_INLINE },
+    { "getConfig", CA_NONE, 0, 0, getConfigCommand, CE_INLINE },
+    { "getTelemetry", CA_NONE, 0, 0, getTelemetryCommand, CE_INLINE },
+    { "getTrends", CA_NONE, 0, 0, getTrendsCommand, CE_INLINE },
+    { "installMqttRootCa", CA_RAW, 0, 0, installMqttRootCaCommand, CE_INLINE },
+    { "installRootCa", CA_RAW, 0, 0, installRootCaCommand, CE_INLINE },
+    { "ota", CA_NONE, 0, 0, otaCommand, CE_INLINE },
+    { "reboot", CA_NONE, 0, 0, rebootCommand, CE_INLINE },
+    { "resetWifi", CA_NONE, 0, 0, resetWifiCommand, CE_INLINE },
+    { "setConfig", CA_PAYLOAD, 0, 0, setConfigCommand, CE_WORKER },
+    { "setSPS30AutoCleanInterval", CA_UINT, 0, UINT32_MAX, setSPS30AutoCleanIntervalCommand, CE_WORKER },
+    { "setTemperatureOffset", CA_FLOAT, 0.0, 10.0, setTemperatureOffsetCommand, CE_WORKER }
+  };
+  static_assert(CommandTable::commandsSorted(COMMAND_TABLE), "COMMAND_TABLE must be sorted by name");
+
+  const Command* const COMMANDS = COMMAND_TABLE;
+  const size_t COMMAND_COUNT = sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]);
+
+}
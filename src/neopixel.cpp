@@ -104,7 +104,7 @@ uint32_t Neopixel::ppmToColour(uint16_t ppm) {
   }
 }
 
-void Neopixel::update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus) {
+void Neopixel::update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightStatus newStatus, const ModelSnapshot& data) {
   if (mask & (M_CONFIG_CHANGED | M_CO2) == 0) return;
   if (mask & M_CONFIG_CHANGED) {
 
@@ -119,11 +119,11 @@ void Neopixel::update(uint16_t mask, TrafficLightStatus oldStatus, TrafficLightS
     this->extStrip->setBrightness(config.brightness);
   }
   if (mask & M_CO2 && !config.colourWheel) {
-    fill(ppmToColour(model->getCo2()));
+    fill(ppmToColour(data.co2));
     if (newStatus == DARK_RED) {
       fill(colourPurple); // Purple
     } else {
-      fill(ppmToColour(model->getCo2()));
+      fill(ppmToColour(data.co2));
     }
   }
 }
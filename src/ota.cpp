@@ -55,7 +55,7 @@ namespace OTA {
     ESP_LOGD(TAG, "OTA done");
   }
 
-  void forceUpdate(char* url) {
+  void forceUpdate(const char* url) {
     forceUpdateURL = String(url);
     xTaskNotify(otaTask, X_CMD_FORCE_UPDATE, eSetBits);
   }
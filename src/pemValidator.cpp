@@ -0,0 +1,82 @@
+#include <pemValidator.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+static const char PEM_BEGIN[] = "-----BEGIN CERTIFICATE-----";
+static const char PEM_END[] = "-----END CERTIFICATE-----";
+
+static boolean isBase64(char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/' || c == '=';
+}
+
+PemValidator::PemValidator() {
+  reset();
+}
+
+void PemValidator::reset() {
+  this->lineLength = 0;
+  this->inBlock = false;
+  this->error = false;
+  this->certificates = 0;
+  this->bodyLength = 0;
+}
+
+void PemValidator::processLine() {
+  this->line[this->lineLength] = 0x00;
+  if (!this->inBlock) {
+    if (this->lineLength == 0) return;
+    if (strcmp(this->line, PEM_BEGIN) == 0) {
+      this->inBlock = true;
+      this->bodyLength = 0;
+    } else {
+      this->error = true;
+    }
+  } else if (strcmp(this->line, PEM_END) == 0) {
+    this->inBlock = false;
+    if (this->bodyLength == 0) {
+      this->error = true;
+    } else {
+      this->certificates++;
+    }
+  } else {
+    for (uint8_t i = 0; i < this->lineLength; i++) {
+      if (!isBase64(this->line[i])) {
+        this->error = true;
+        return;
+      }
+    }
+    this->bodyLength += this->lineLength;
+  }
+}
+
+void PemValidator::update(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length && !this->error; i++) {
+    char c = (char)data[i];
+    if (c == '\r') continue;
+    if (c == '\n') {
+      processLine();
+      this->lineLength = 0;
+    } else if (this->lineLength >= PEM_MAX_LINE || c == 0x00) {
+      this->error = true;
+    } else {
+      this->line[this->lineLength++] = c;
+    }
+  }
+}
+
+boolean PemValidator::finish() {
+  if (!this->error && this->lineLength > 0) {
+    processLine();
+    this->lineLength = 0;
+  }
+  return !this->error && !this->inBlock && this->certificates > 0;
+}
+
+boolean PemValidator::hasError() {
+  return this->error;
+}
+
+uint8_t PemValidator::getCertificates() {
+  return this->certificates;
+}
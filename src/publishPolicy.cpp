@@ -0,0 +1,74 @@
+#include <publishPolicy.h>
+#include <configManager.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+PublishPolicy::PublishPolicy() {
+  reset();
+}
+
+void PublishPolicy::reset() {
+  for (uint8_t i = 0; i < PUBLISH_POLICY_METRICS; i++) {
+    this->lastValue[i] = 0;
+    this->lastPublished[i] = 0;
+  }
+  this->published = M_NONE;
+  this->suppressed = 0;
+}
+
+uint32_t PublishPolicy::getSuppressed() {
+  return this->suppressed;
+}
+
+// values are compared in the resolution they are published with, i.e. 1/10 for temperature and humidity
+int32_t PublishPolicy::getValue(const ModelSnapshot& data, uint8_t metric) {
+  switch (1 << metric) {
+    case M_CO2: return data.co2;
+    case M_TEMPERATURE: return isnan(data.temperature) ? INT32_MIN : lroundf(data.temperature * 10);
+    case M_HUMIDITY: return isnan(data.humidity) ? INT32_MIN : lroundf(data.humidity * 10);
+    case M_PRESSURE: return data.pressure;
+    case M_IAQ: return data.iaq;
+    case M_PM0_5: return data.pm0_5;
+    case M_PM1_0: return data.pm1;
+    case M_PM2_5: return data.pm2_5;
+    case M_PM4: return data.pm4;
+    case M_PM10: return data.pm10;
+  }
+  return 0;
+}
+
+uint16_t PublishPolicy::getDeadband(uint8_t metric) {
+  switch (1 << metric) {
+    case M_CO2: return config.deadbandCo2;
+    case M_TEMPERATURE: return config.deadbandTemperature;
+    case M_HUMIDITY: return config.deadbandHumidity;
+    case M_PM0_5:
+    case M_PM1_0:
+    case M_PM2_5:
+    case M_PM4:
+    case M_PM10: return config.deadbandPm;
+  }
+  return 0;
+}
+
+uint16_t PublishPolicy::apply(SensorSample& sample, uint32_t now) {
+  uint16_t mask = M_NONE;
+  uint32_t heartbeat = config.sensorsHeartbeat * 1000UL;
+  for (uint8_t metric = 0; metric < PUBLISH_POLICY_METRICS; metric++) {
+    uint16_t bit = 1 << metric;
+    if (!(sample.mask & bit)) continue;
+    int32_t value = getValue(sample.data, metric);
+    if (!(this->published & bit)
+      || llabs((int64_t)value - this->lastValue[metric]) >= getDeadband(metric)
+      || (heartbeat > 0 && now - this->lastPublished[metric] >= heartbeat)) {
+      mask |= bit;
+      this->lastValue[metric] = value;
+      this->lastPublished[metric] = now;
+      this->published |= bit;
+    }
+  }
+  if (mask == M_NONE) this->suppressed++;
+  sample.mask = mask;
+  return mask;
+}
@@ -0,0 +1,196 @@
+#include <sampleStore.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+SampleStore::SampleStore(FS* _fs, const char* _filename, uint16_t _maxPages) {
+  this->fs = _fs;
+  this->filename = _filename;
+  this->maxPages = _maxPages;
+  this->boot = 0;
+  this->pageCount = 0;
+  this->pageRead = 0;
+  this->firstPage = 0;
+  this->nextPage = 0;
+  this->fileRead = 0;
+  this->dropped = 0;
+  this->pagesWritten = 0;
+}
+
+SampleStore::~SampleStore() {}
+
+// picks up the unreplayed pages of previous boots, this boot is numbered one after the newest of them
+void SampleStore::begin() {
+  if (!this->fs->exists(this->filename)) return;
+  File file = this->fs->open(this->filename, FILE_READ);
+  if (!file) {
+    ESP_LOGW(TAG, "Could not open %s", this->filename);
+    return;
+  }
+  uint32_t valid = 0;
+  uint32_t lastBoot = 0;
+  SampleStorePageHeader header;
+  for (uint16_t slot = 0; slot < this->maxPages; slot++) {
+    if (!file.seek(slot * SAMPLE_STORE_PAGE_SIZE) || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) break;
+    // replayed, or from a firmware with a different sample layout
+    if (header.magic != SAMPLE_STORE_MAGIC || header.count != SAMPLE_STORE_PAGE_SAMPLES) continue;
+    // written with a different number of slots
+    if (header.sequence % this->maxPages != slot) {
+      valid = 0;
+      break;
+    }
+    if (valid == 0 || (int32_t)(header.sequence - this->firstPage) < 0) this->firstPage = header.sequence;
+    if (valid == 0 || (int32_t)(header.sequence - this->nextPage) >= 0) this->nextPage = header.sequence + 1;
+    if (valid == 0 || header.boot > lastBoot) lastBoot = header.boot;
+    valid++;
+  }
+  file.close();
+  this->boot = lastBoot + 1;
+  // the pages in between must all be there, otherwise the ring can't be followed
+  if (valid == 0 || this->nextPage - this->firstPage != valid) {
+    ESP_LOGI(TAG, "Nothing to replay in %s", this->filename);
+    this->fs->remove(this->filename);
+    this->firstPage = 0;
+    this->nextPage = 0;
+    return;
+  }
+  ESP_LOGI(TAG, "%u samples from previous boots to replay", size());
+}
+
+uint32_t SampleStore::filePages() {
+  return this->nextPage - this->firstPage;
+}
+
+uint32_t SampleStore::pageOffset(uint32_t sequence) {
+  return (sequence % this->maxPages) * SAMPLE_STORE_PAGE_SIZE;
+}
+
+uint32_t SampleStore::size() {
+  return filePages() * SAMPLE_STORE_PAGE_SAMPLES - this->fileRead + this->pageCount - this->pageRead;
+}
+
+uint32_t SampleStore::getBoot() {
+  return this->boot;
+}
+
+uint32_t SampleStore::getDropped() {
+  return this->dropped;
+}
+
+uint32_t SampleStore::getPagesWritten() {
+  return this->pagesWritten;
+}
+
+boolean SampleStore::writePage() {
+  File file = this->fs->open(this->filename, this->fs->exists(this->filename) ? "r+" : FILE_WRITE);
+  if (!file) {
+    ESP_LOGW(TAG, "Could not open %s", this->filename);
+    return false;
+  }
+  if (filePages() >= this->maxPages) {
+    // all slots taken, the oldest page makes room
+    this->dropped += SAMPLE_STORE_PAGE_SAMPLES - this->fileRead;
+    this->firstPage++;
+    this->fileRead = 0;
+  }
+  this->page.header = { SAMPLE_STORE_MAGIC, this->nextPage, this->boot, SAMPLE_STORE_PAGE_SAMPLES };
+  // slots are filled in order, the next one is at most right after the end of the file
+  size_t written = 0;
+  if (file.seek(pageOffset(this->nextPage))) {
+    written = file.write((uint8_t*)&this->page, sizeof(this->page));
+    // always write the whole page, the unused tail keeps pages aligned to flash blocks
+    uint8_t padding[16] = { 0 };
+    while (written >= sizeof(this->page) && written < SAMPLE_STORE_PAGE_SIZE) {
+      size_t n = file.write(padding, min(sizeof(padding), (size_t)(SAMPLE_STORE_PAGE_SIZE - written)));
+      if (n == 0) break;
+      written += n;
+    }
+  }
+  file.close();
+  if (written != SAMPLE_STORE_PAGE_SIZE) {
+    ESP_LOGW(TAG, "Failed to write page to %s", this->filename);
+    return false;
+  }
+  this->nextPage++;
+  this->pagesWritten++;
+  this->pageCount = 0;
+  return true;
+}
+
+boolean SampleStore::append(const SensorSample& sample) {
+  if (this->pageCount >= SAMPLE_STORE_PAGE_SAMPLES) {
+    if (this->pageRead > 0) {
+      // page has been partially replayed, make room at the front
+      memmove(this->page.samples, &this->page.samples[this->pageRead], (this->pageCount - this->pageRead) * sizeof(SensorSample));
+      this->pageCount -= this->pageRead;
+      this->pageRead = 0;
+    } else if (!writePage()) {
+      this->dropped++;
+      return false;
+    }
+  }
+  this->page.samples[this->pageCount++] = sample;
+  return true;
+}
+
+uint8_t SampleStore::read(SensorSample* samples, uint8_t count, boolean* previousBoot) {
+  if (previousBoot) *previousBoot = false;
+  if (filePages() > 0) {
+    File file = this->fs->open(this->filename, FILE_READ);
+    if (!file) {
+      ESP_LOGW(TAG, "Could not open %s", this->filename);
+      return 0;
+    }
+    // only from the oldest page, so all samples share its boot
+    SampleStorePageHeader header;
+    uint8_t n = min((uint32_t)count, (uint32_t)(SAMPLE_STORE_PAGE_SAMPLES - this->fileRead));
+    uint32_t offset = pageOffset(this->firstPage);
+    if (!file.seek(offset) || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)
+      || !file.seek(offset + offsetof(SampleStorePage, samples) + this->fileRead * sizeof(SensorSample))
+      || file.read((uint8_t*)samples, n * sizeof(SensorSample)) != n * sizeof(SensorSample)) {
+      ESP_LOGW(TAG, "Failed to read from %s", this->filename);
+      file.close();
+      return 0;
+    }
+    file.close();
+    if (previousBoot) *previousBoot = header.boot != this->boot;
+    return n;
+  }
+  uint8_t n = 0;
+  while (n < count && this->pageRead + n < this->pageCount) {
+    samples[n] = this->page.samples[this->pageRead + n];
+    n++;
+  }
+  return n;
+}
+
+// marks the oldest page as replayed, so it isn't picked up again after a reboot
+void SampleStore::pageReplayed() {
+  uint32_t offset = pageOffset(this->firstPage);
+  this->firstPage++;
+  this->fileRead = 0;
+  if (filePages() == 0) {
+    this->fs->remove(this->filename);
+    this->firstPage = 0;
+    this->nextPage = 0;
+    return;
+  }
+  File file = this->fs->open(this->filename, "r+");
+  uint32_t magic = 0;
+  if (!file || !file.seek(offset) || file.write((uint8_t*)&magic, sizeof(magic)) != sizeof(magic))
+    ESP_LOGW(TAG, "Failed to mark page in %s", this->filename);
+  if (file) file.close();
+}
+
+void SampleStore::consume(uint8_t count) {
+  if (filePages() > 0) {
+    this->fileRead = min(this->fileRead + count, (uint32_t)SAMPLE_STORE_PAGE_SAMPLES);
+    if (this->fileRead == SAMPLE_STORE_PAGE_SAMPLES) pageReplayed();
+    return;
+  }
+  this->pageRead = min((uint16_t)(this->pageRead + count), this->pageCount);
+  if (this->pageRead == this->pageCount) {
+    this->pageCount = 0;
+    this->pageRead = 0;
+  }
+}
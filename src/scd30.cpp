@@ -4,6 +4,7 @@
 #include <Arduino.h>
 
 #include <configManager.h>
+#include <latency.h>
 #include <i2c.h>
 #include <esp32-hal-timer.h>
 #include "freertos/FreeRTOS.h"
@@ -19,57 +20,60 @@ SCD30::SCD30(TwoWire* wire, Model* _model, updateMessageCallback_t _updateMessag
   this->updateMessageCallback = _updateMessageCallback;
   this->scd30 = new Adafruit_SCD30();
 
-  if (!I2C::takeMutex(portMAX_DELAY)) return;
-  Wire.setClock(SCD30_I2C_CLK);
-
-  uint8_t retry = 0;
-  while (retry < MAX_RETRY && !scd30->begin(SCD30_I2CADDR_DEFAULT, wire, 0)) retry++;
-  if (retry >= MAX_RETRY) {
-    ESP_LOGW(TAG, "Failed to find SCD30 chip");
-  }
-
-  retry = 0;
-  while (retry < MAX_RETRY && !scd30->setMeasurementInterval(SCD30_INTERVAL)) retry++;
-  if (retry >= MAX_RETRY) {
-    ESP_LOGW(TAG, "Failed to set measurement interval");
-  }
-  ESP_LOGD(TAG, "Measurement interval: %u sec", scd30->getMeasurementInterval());
+  struct Init {
+    Adafruit_SCD30* scd30;
+    TwoWire* wire;
+  } init = { this->scd30, wire };
+  I2C::transact(SCD30_I2C_ADR, SCD30_I2C_CLK, +[](Init* init) -> boolean {
+    Adafruit_SCD30* scd30 = init->scd30;
+    uint8_t retry = 0;
+    while (retry < MAX_RETRY && !scd30->begin(SCD30_I2CADDR_DEFAULT, init->wire, 0)) retry++;
+    if (retry >= MAX_RETRY) {
+      ESP_LOGW(TAG, "Failed to find SCD30 chip");
+    }
 
-  ESP_LOGD(TAG, "Ambient pressure offset: %u mBar", scd30->getAmbientPressureOffset());
+    retry = 0;
+    while (retry < MAX_RETRY && !scd30->setMeasurementInterval(SCD30_INTERVAL)) retry++;
+    if (retry >= MAX_RETRY) {
+      ESP_LOGW(TAG, "Failed to set measurement interval");
+    }
+    ESP_LOGD(TAG, "Measurement interval: %u sec", scd30->getMeasurementInterval());
 
-  retry = 0;
-  while (retry < MAX_RETRY && !scd30->setAltitudeOffset(config.altitude)) retry++;
-  if (retry >= MAX_RETRY) {
-    ESP_LOGW(TAG, "Failed to set altitude offset");
-  }
-  ESP_LOGD(TAG, "Altitude offset: %u m", scd30->getAltitudeOffset());
+    ESP_LOGD(TAG, "Ambient pressure offset: %u mBar", scd30->getAmbientPressureOffset());
 
-  /*
     retry = 0;
-    while (retry < MAX_RETRY && !scd30->setTemperatureOffset(430)) retry++;
+    while (retry < MAX_RETRY && !scd30->setAltitudeOffset(config.altitude)) retry++;
     if (retry >= MAX_RETRY) {
-      ESP_LOGW(TAG, "Failed to set temperature offset");
+      ESP_LOGW(TAG, "Failed to set altitude offset");
     }
-  */
+    ESP_LOGD(TAG, "Altitude offset: %u m", scd30->getAltitudeOffset());
 
-  ESP_LOGD(TAG, "Temperature offset: %.1f C", (float)scd30->getTemperatureOffset() / 100.0);
+    /*
+      retry = 0;
+      while (retry < MAX_RETRY && !scd30->setTemperatureOffset(430)) retry++;
+      if (retry >= MAX_RETRY) {
+        ESP_LOGW(TAG, "Failed to set temperature offset");
+      }
+    */
 
-  ESP_LOGD(TAG, "Forced Recalibration reference: %u ppm", scd30->getForcedCalibrationReference());
+    ESP_LOGD(TAG, "Temperature offset: %.1f C", (float)scd30->getTemperatureOffset() / 100.0);
 
-  retry = 0;
-  while (retry < MAX_RETRY && !scd30->selfCalibrationEnabled(true)) retry++;
-  if (retry >= MAX_RETRY) {
-    ESP_LOGW(TAG, "Failed to enable self calibration");
-  }
-  ESP_LOGD(TAG, "Self calibration %s", scd30->selfCalibrationEnabled() ? "enabled" : "disabled");
+    ESP_LOGD(TAG, "Forced Recalibration reference: %u ppm", scd30->getForcedCalibrationReference());
 
-  retry = 0;
-  while (retry < MAX_RETRY && !scd30->startContinuousMeasurement()) retry++;
-  if (retry >= MAX_RETRY) {
-    ESP_LOGW(TAG, "Failed to start continuous measurement");
-  }
-  Wire.setClock(I2C_CLK);
-  I2C::giveMutex();
+    retry = 0;
+    while (retry < MAX_RETRY && !scd30->selfCalibrationEnabled(true)) retry++;
+    if (retry >= MAX_RETRY) {
+      ESP_LOGW(TAG, "Failed to enable self calibration");
+    }
+    ESP_LOGD(TAG, "Self calibration %s", scd30->selfCalibrationEnabled() ? "enabled" : "disabled");
+
+    retry = 0;
+    while (retry < MAX_RETRY && !scd30->startContinuousMeasurement()) retry++;
+    if (retry >= MAX_RETRY) {
+      ESP_LOGW(TAG, "Failed to start continuous measurement");
+    }
+    return (retry < MAX_RETRY);
+  }, &init);
   initialised = true;
   ESP_LOGD(TAG, "SCD30 initialised");
 }
@@ -86,11 +90,12 @@ boolean SCD30::readScd30() {
 #ifdef SHOW_DEBUG_MSGS
   this->updateMessageCallback("readScd30");
 #endif
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  Wire.setClock(SCD30_I2C_CLK);
-  boolean read = scd30->dataReady() && scd30->read();
-  Wire.setClock(I2C_CLK);
-  I2C::giveMutex();
+  boolean read = I2C::transact(SCD30_I2C_ADR, SCD30_I2C_CLK, +[](Adafruit_SCD30* scd30) -> boolean {
+    uint32_t start = Latency::now();
+    boolean read = scd30->dataReady() && scd30->read();
+    if (read) Latency::recordSince(LS_SENSOR_READ, start);
+    return read;
+  }, scd30);
   if (read) {
     ESP_LOGD(TAG, "Temp: %.1fC, rH: %.1f%%, CO2:  %.0fppm", scd30->temperature, scd30->relative_humidity, scd30->CO2);
 #ifdef SHOW_DEBUG_MSGS
@@ -107,25 +112,31 @@ boolean SCD30::readScd30() {
   return false;
 }
 
+// a setting to write or read, for the transactions
+struct Scd30Value {
+  Adafruit_SCD30* scd30;
+  float value;
+};
+
 boolean SCD30::calibrateScd30ToReference(uint16_t co2Reference) {
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  Wire.setClock(SCD30_I2C_CLK);
-  uint8_t retry = 0;
-  while (retry++ < MAX_RETRY && !scd30->forceRecalibrationWithReference(co2Reference));
-  ESP_LOGD(TAG, "co2Reference: %u, result %s", co2Reference, (retry < MAX_RETRY) ? "true" : "false");
-  Wire.setClock(I2C_CLK);
-  I2C::giveMutex();
-  return (retry < MAX_RETRY);
+  Scd30Value calibration = { scd30, (float)co2Reference };
+  return I2C::transact(SCD30_I2C_ADR, SCD30_I2C_CLK, +[](Scd30Value* calibration) -> boolean {
+    uint16_t co2Reference = (uint16_t)calibration->value;
+    uint8_t retry = 0;
+    while (retry++ < MAX_RETRY && !calibration->scd30->forceRecalibrationWithReference(co2Reference));
+    ESP_LOGD(TAG, "co2Reference: %u, result %s", co2Reference, (retry < MAX_RETRY) ? "true" : "false");
+    return (retry < MAX_RETRY);
+  }, &calibration);
 }
 
 float SCD30::getTemperatureOffset() {
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  Wire.setClock(SCD30_I2C_CLK);
-  float temperatureOffset = scd30->getTemperatureOffset() / 100.0;
-  ESP_LOGD(TAG, "Temperature offset: %.1f C", temperatureOffset);
-  Wire.setClock(I2C_CLK);
-  I2C::giveMutex();
-  return temperatureOffset;
+  Scd30Value temperatureOffset = { scd30, NaN };
+  I2C::transact(SCD30_I2C_ADR, SCD30_I2C_CLK, +[](Scd30Value* temperatureOffset) -> boolean {
+    temperatureOffset->value = temperatureOffset->scd30->getTemperatureOffset() / 100.0;
+    ESP_LOGD(TAG, "Temperature offset: %.1f C", temperatureOffset->value);
+    return true;
+  }, &temperatureOffset);
+  return temperatureOffset.value;
 }
 
 boolean SCD30::setTemperatureOffset(float temperatureOffset) {
@@ -133,15 +144,14 @@ boolean SCD30::setTemperatureOffset(float temperatureOffset) {
     ESP_LOGW(TAG, "Negative temperature offset not supported");
     return false;
   }
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  Wire.setClock(SCD30_I2C_CLK);
-  uint8_t retry = 0;
-  while (retry < MAX_RETRY && !scd30->setTemperatureOffset(floor(temperatureOffset * 100))) retry++;
-  if (retry >= MAX_RETRY)
-    ESP_LOGW(TAG, "Failed to set temperature offset");
-  Wire.setClock(I2C_CLK);
-  I2C::giveMutex();
-  return (retry < MAX_RETRY);
+  Scd30Value offset = { scd30, temperatureOffset };
+  return I2C::transact(SCD30_I2C_ADR, SCD30_I2C_CLK, +[](Scd30Value* offset) -> boolean {
+    uint8_t retry = 0;
+    while (retry < MAX_RETRY && !offset->scd30->setTemperatureOffset(floor(offset->value * 100))) retry++;
+    if (retry >= MAX_RETRY)
+      ESP_LOGW(TAG, "Failed to set temperature offset");
+    return (retry < MAX_RETRY);
+  }, &offset);
 }
 
 boolean SCD30::setAmbientPressure(uint16_t ambientPressureInHpa) {
@@ -149,13 +159,12 @@ boolean SCD30::setAmbientPressure(uint16_t ambientPressureInHpa) {
   if (ambientPressureInHpa == lastAmbientPressure) return true;
   lastAmbientPressure = ambientPressureInHpa;
   ESP_LOGD(TAG, "setAmbientPressure: %u", ambientPressureInHpa);
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  Wire.setClock(SCD30_I2C_CLK);
-  boolean success = scd30->startContinuousMeasurement(ambientPressureInHpa);
+  Scd30Value pressure = { scd30, (float)ambientPressureInHpa };
+  boolean success = I2C::transact(SCD30_I2C_ADR, SCD30_I2C_CLK, +[](Scd30Value* pressure) -> boolean {
+    return pressure->scd30->startContinuousMeasurement((uint16_t)pressure->value);
+  }, &pressure);
   if (!success) {
     ESP_LOGD(TAG, "failed to setAmbientPressure");
   }
-  Wire.setClock(I2C_CLK);
-  I2C::giveMutex();
   return success;
 }
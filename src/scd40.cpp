@@ -5,87 +5,140 @@
 
 #include <i2c.h>
 #include <configManager.h>
+#include <latency.h>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
 
+#define SCD40_GET_DATA_READY_STATUS 0xe4b8
+#define SCD40_READ_MEASUREMENT 0xec05
+#define SCD40_COMMAND_DELAY_MS 1
+#define SCD40_MAX_WORDS 3
+
 boolean SCD40::checkError(uint16_t error, char const* msg) {
   if (error != 0) {
     char errorMessage[256];
     errorToString(error, errorMessage, 256);
     ESP_LOGW(TAG, "Error trying to execute %s: %s", msg, errorMessage);
-    I2C::giveMutex();
 #ifdef SHOW_DEBUG_MSGS
     this->updateMessageCallback("error SCD40 cmd");
 #endif
-    while (!I2C::takeMutex(portMAX_DELAY));
     return false;
   }
   return true;
 }
 
-SCD40::SCD40(TwoWire* wire, Model* _model, updateMessageCallback_t _updateMessageCallback) {
+// CRC-8 over one data word, polynomial 0x31, initialised with 0xff
+static uint8_t sensirionCrc(const uint8_t* data) {
+  uint8_t crc = 0xff;
+  for (uint8_t i = 0; i < 2; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+  }
+  return crc;
+}
+
+boolean SCD40::readWords(uint16_t command, uint16_t* words, uint8_t count) {
+  if (count > SCD40_MAX_WORDS) return false;
+  uint8_t request[2] = { (uint8_t)(command >> 8), (uint8_t)command };
+  uint8_t response[3 * SCD40_MAX_WORDS];
+  I2C::Transaction transaction;
+  memset(&transaction, 0, sizeof(I2C::Transaction));
+  transaction.address = SCD40_I2C_ADR;
+  transaction.clock = I2C_CLK;
+  transaction.writeBuffer = request;
+  transaction.writeLength = sizeof(request);
+  transaction.readBuffer = response;
+  transaction.readLength = 3 * count;
+  transaction.readDelayMs = SCD40_COMMAND_DELAY_MS;
+  if (!I2C::transact(transaction)) {
+    ESP_LOGW(TAG, "Error trying to execute command %x", command);
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if (sensirionCrc(&response[3 * i]) != response[3 * i + 2]) {
+      ESP_LOGW(TAG, "CRC error in response to command %x", command);
+      return false;
+    }
+    words[i] = (response[3 * i] << 8) | response[3 * i + 1];
+  }
+  return true;
+}
+
+SCD40::SCD40(TwoWire* wire, Model* _model, updateMessageCallback_t _updateMessageCallback, scd40CommandResultCallback_t _commandResultCallback) {
   this->model = _model;
   this->updateMessageCallback = _updateMessageCallback;
+  this->commandResultCallback = _commandResultCallback;
   this->scd40 = new SensirionI2CScd4x();
   this->sampleRate = PERIODIC;
+  this->commandQueue = xQueueCreate(SCD40_COMMAND_QUEUE_LENGTH, sizeof(SCD40Command));
+  this->settings.temperatureOffset = NaN;
+  this->settings.altitude = 0;
+  this->settings.ascEnabled = false;
   ESP_LOGD(TAG, "Initialising SCD40");
 
-  if (!I2C::takeMutex(portMAX_DELAY)) return;
-
-  scd40->begin(*wire);
+  struct Init {
+    SCD40* self;
+    TwoWire* wire;
+  } init = { this, wire };
+  I2C::transact(SCD40_I2C_ADR, I2C_CLK, +[](Init* init) -> boolean {
+    SCD40* self = init->self;
+    self->scd40->begin(*init->wire);
 
-  // stop potentially previously started measurement
-  checkError(scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
+    // stop potentially previously started measurement
+    self->checkError(self->scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
 
-  vTaskDelay(pdMS_TO_TICKS(500));
+    vTaskDelay(pdMS_TO_TICKS(500));
 
-  /*
-    uint16_t sensorStatus;
-    ESP_LOGD(TAG, "Performing sensor self test...");
-    if (checkError(scd40->performSelfTest(sensorStatus), "performSelfTest")) {
-      if (sensorStatus != 0) {
-        ESP_LOGW(TAG, "Self check error: %x", sensorStatus);
-        //      checkError(scd40->performFactoryReset(), "performFactoryReset");
+    /*
+      uint16_t sensorStatus;
+      ESP_LOGD(TAG, "Performing sensor self test...");
+      if (self->checkError(self->scd40->performSelfTest(sensorStatus), "performSelfTest")) {
+        if (sensorStatus != 0) {
+          ESP_LOGW(TAG, "Self check error: %x", sensorStatus);
+          //      self->checkError(self->scd40->performFactoryReset(), "performFactoryReset");
+        }
       }
-    }
-  */
-
-  uint16_t serialNo[3];
-  if (checkError(scd40->getSerialNumber(serialNo[0], serialNo[1], serialNo[2]), "getSerialNumber")) {
-    ESP_LOGD(TAG, "SCD40 serial#: %x%x%x", serialNo[0], serialNo[1], serialNo[2]);
-  }
+    */
 
-  uint16_t ascEnabled;
-  if (checkError(scd40->getAutomaticSelfCalibration(ascEnabled), "getAutomaticSelfCalibration")) {
-    ESP_LOGD(TAG, "Automatic self-calibration: %u", ascEnabled);
-    if (ascEnabled != 1) {
-      checkError(scd40->setAutomaticSelfCalibration(0x01), "setAutomaticSelfCalibration");
-      checkError(scd40->persistSettings(), "persistSettings");
+    uint16_t serialNo[3];
+    if (self->checkError(self->scd40->getSerialNumber(serialNo[0], serialNo[1], serialNo[2]), "getSerialNumber")) {
+      ESP_LOGD(TAG, "SCD40 serial#: %x%x%x", serialNo[0], serialNo[1], serialNo[2]);
     }
-  }
 
-  uint16_t sensor_altitude;
-  if (checkError(scd40->getSensorAltitude(sensor_altitude), "getSensorAltitude")) {
-    if (sensor_altitude != config.altitude) {
-      checkError(scd40->setSensorAltitude(config.altitude), "setSensorAltitude");
-      checkError(scd40->persistSettings(), "persistSettings");
+    uint16_t ascEnabled;
+    if (self->checkError(self->scd40->getAutomaticSelfCalibration(ascEnabled), "getAutomaticSelfCalibration")) {
+      ESP_LOGD(TAG, "Automatic self-calibration: %u", ascEnabled);
+      self->settings.ascEnabled = ascEnabled == 1;
+      if (ascEnabled != 1) {
+        if (self->checkError(self->scd40->setAutomaticSelfCalibration(0x01), "setAutomaticSelfCalibration")) self->settings.ascEnabled = true;
+        self->checkError(self->scd40->persistSettings(), "persistSettings");
+      }
     }
-  }
 
-  float temperature_offset;
-  if (checkError(scd40->getTemperatureOffset(temperature_offset), "getTemperatureOffset")) {
-    ESP_LOGD(TAG, "Temperature offset: %.1f", temperature_offset);
-  }
+    uint16_t sensor_altitude;
+    if (self->checkError(self->scd40->getSensorAltitude(sensor_altitude), "getSensorAltitude")) {
+      self->settings.altitude = sensor_altitude;
+      if (sensor_altitude != config.altitude) {
+        if (self->checkError(self->scd40->setSensorAltitude(config.altitude), "setSensorAltitude")) self->settings.altitude = config.altitude;
+        self->checkError(self->scd40->persistSettings(), "persistSettings");
+      }
+    }
 
-  startMeasurement();
+    float temperature_offset;
+    if (self->checkError(self->scd40->getTemperatureOffset(temperature_offset), "getTemperatureOffset")) {
+      ESP_LOGD(TAG, "Temperature offset: %.1f", temperature_offset);
+      self->settings.temperatureOffset = temperature_offset;
+    }
 
-  I2C::giveMutex();
+    return self->startMeasurement();
+  }, &init);
   ESP_LOGD(TAG, "SCD40 initialised");
 }
 
 SCD40::~SCD40() {
   if (this->scd40) delete scd40;
+  if (this->commandQueue) vQueueDelete(commandQueue);
 }
 
 boolean SCD40::startMeasurement() {
@@ -99,10 +152,10 @@ boolean SCD40::startMeasurement() {
 
 void SCD40::shutdown() {
   if (this->scd40) {
-    if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return;
-    boolean success = checkError(scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
-    success = checkError(scd40->powerDown(), "powerDown");
-    I2C::giveMutex();
+    I2C::transact(SCD40_I2C_ADR, I2C_CLK, +[](SCD40* self) -> boolean {
+      self->checkError(self->scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
+      return self->checkError(self->scd40->powerDown(), "powerDown");
+    }, this);
   }
 }
 
@@ -110,20 +163,14 @@ boolean SCD40::setSampleRate(SCD40SampleRate _sampleRate) {
   // ESP_LOGD(TAG, "SCD40::setSampleRate()");
   if (this->sampleRate != _sampleRate) {
     this->sampleRate = _sampleRate;
-    if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-    boolean success = checkError(scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
+    boolean success = I2C::transact(SCD40_I2C_ADR, I2C_CLK, +[](SCD40* self) -> boolean {
+      return self->checkError(self->scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement")
+        && self->startMeasurement();
+    }, this);
     if (!success) {
-      I2C::giveMutex();
       ESP_LOGD(TAG, "failed to setSampleRate");
       return false;
     }
-    success = startMeasurement();
-    if (!success) {
-      I2C::giveMutex();
-      ESP_LOGD(TAG, "failed to setSampleRate");
-      return false;
-    }
-    I2C::giveMutex();
   }
   // ESP_LOGD(TAG, "done");
   return true;
@@ -144,12 +191,8 @@ boolean SCD40::readScd40() {
   this->updateMessageCallback("readScd40");
 #endif
 
-  // check if data is ready
   uint16_t dataReady;
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  boolean success = checkError(scd40->getDataReadyStatus(dataReady), "getDataReadyStatus");
-  I2C::giveMutex();
-  if (!success) return false;
+  if (!readWords(SCD40_GET_DATA_READY_STATUS, &dataReady, 1)) return false;
   if ((dataReady & 0x07ff) == 0) {
 #ifdef SHOW_DEBUG_MSGS
     this->updateMessageCallback("SCD40 not ready");
@@ -158,13 +201,15 @@ boolean SCD40::readScd40() {
     return false;
   }
 
-  float temperature, humidity = NaN;
-  uint16_t co2 = 0x0000u;
   // Read Measurement
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  success = checkError(scd40->readMeasurement(co2, temperature, humidity), "readMeasurement");
-  I2C::giveMutex();
-  if (!success) return false;
+  uint16_t measurement[3];
+  uint32_t start = Latency::now();
+  if (!readWords(SCD40_READ_MEASUREMENT, measurement, 3)) return false;
+  Latency::recordSince(LS_SENSOR_READ, start);
+  uint16_t co2 = measurement[0];
+  // same scaling as the Sensirion library
+  float temperature = -45.0f + 175.0f * measurement[1] / 65536.0f;
+  float humidity = 100.0f * measurement[2] / 65536.0f;
   ESP_LOGD(TAG, "Temp: %.1fC, rH: %.1f%%, CO2:  %uppm", temperature, humidity, co2);
 #ifdef SHOW_DEBUG_MSGS
   this->updateMessageCallback("");
@@ -181,87 +226,129 @@ boolean SCD40::readScd40() {
   return false;
 }
 
-boolean SCD40::calibrateScd40ToReference(uint16_t co2Reference) {
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  boolean success = checkError(scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
-  if (!success) {
-    I2C::giveMutex();
-    ESP_LOGD(TAG, "failed to calibrateScd40ToReference");
-    return false;
+uint32_t SCD40::step() {
+  if (this->stopped) {
+    applyCommands();
+    return getInterval() * 1000;
   }
-  vTaskDelay(pdMS_TO_TICKS(500));
-  uint16_t frcCorrection;
-  success = checkError(scd40->performForcedRecalibration(co2Reference, frcCorrection), "performForcedRecalibration");
-  if (!success) {
-    I2C::giveMutex();
-    ESP_LOGD(TAG, "failed to calibrateScd40ToReference");
-    return false;
+  if (this->commandQueue && uxQueueMessagesWaiting(commandQueue) > 0) {
+    // the sensor only takes configuration commands when idle and needs 500ms to get there
+    this->stopped = I2C::transact(SCD40_I2C_ADR, I2C_CLK, +[](SCD40* self) -> boolean {
+      return self->checkError(self->scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
+    }, this);
+    if (this->stopped) return SCD40_STOP_MS;
+    return getInterval() * 1000;
   }
-  ESP_LOGD(TAG, "co2Reference: %u, frcCorrection %u", co2Reference, frcCorrection);
-  success = startMeasurement();
-  I2C::giveMutex();
-  return success;
+  readScd40();
+  return getInterval() * 1000;
 }
 
-float SCD40::getTemperatureOffset() {
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  boolean success = checkError(scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
-  if (!success) {
-    I2C::giveMutex();
-    ESP_LOGD(TAG, "failed to getTemperatureOffset");
+boolean SCD40::queueCommand(SCD40CommandType type, float value, const char* id) {
+  SCD40Command command;
+  command.type = type;
+  command.value = value;
+  strncpy(command.id, id ? id : "", COMMAND_ID_LEN);
+  command.id[COMMAND_ID_LEN] = 0x00;
+  if (!this->commandQueue || xQueueSendToBack(commandQueue, &command, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "SCD40 command queue full");
     return false;
   }
-  vTaskDelay(pdMS_TO_TICKS(500));
-  float temperatureOffset;
-  success = checkError(scd40->getTemperatureOffset(temperatureOffset), "getTemperatureOffset");
-  if (!success) {
-    I2C::giveMutex();
-    ESP_LOGD(TAG, "failed to getTemperatureOffset");
-    return false;
+  return true;
+}
+
+boolean SCD40::applyCommand(const SCD40Command& command) {
+  switch (command.type) {
+    case SCD40_SET_TEMPERATURE_OFFSET:
+      if (!checkError(scd40->setTemperatureOffset(command.value), "setTemperatureOffset")) {
+        if (this->commandResultCallback) this->commandResultCallback(command.type, command.id, false, 0);
+        return false;
+      }
+      ESP_LOGD(TAG, "setTemperatureOffset: %.1f", command.value);
+      this->settings.temperatureOffset = command.value;
+      if (this->commandResultCallback) this->commandResultCallback(command.type, command.id, true, 0);
+      return true;
+    case SCD40_SET_ALTITUDE:
+      if (!checkError(scd40->setSensorAltitude((uint16_t)command.value), "setSensorAltitude")) return false;
+      ESP_LOGD(TAG, "setSensorAltitude: %u", (uint16_t)command.value);
+      this->settings.altitude = (uint16_t)command.value;
+      return true;
+    case SCD40_SET_ASC:
+      if (!checkError(scd40->setAutomaticSelfCalibration(command.value != 0 ? 0x01 : 0x00), "setAutomaticSelfCalibration")) return false;
+      this->settings.ascEnabled = command.value != 0;
+      return true;
+    case SCD40_FORCED_RECALIBRATION:
+    {
+      uint16_t frcCorrection = 0xffff;
+      // 0xffff is the sensor reporting a failed recalibration, otherwise the correction is offset by 0x8000
+      boolean success = checkError(scd40->performForcedRecalibration((uint16_t)command.value, frcCorrection), "performForcedRecalibration")
+        && frcCorrection != 0xffff;
+      int16_t correction = success ? (int16_t)(frcCorrection - 0x8000) : 0;
+      if (success) {
+        ESP_LOGD(TAG, "co2Reference: %u, frcCorrection %d ppm", (uint16_t)command.value, correction);
+      } else {
+        ESP_LOGW(TAG, "Forced recalibration to %u failed", (uint16_t)command.value);
+      }
+      if (this->commandResultCallback) this->commandResultCallback(command.type, command.id, success, correction);
+      return false; // nothing to persist
+    }
+    default:
+      return false;
   }
-  ESP_LOGD(TAG, "getTemperatureOffset: %.1f", temperatureOffset);
-  success = startMeasurement();
-  I2C::giveMutex();
-  return temperatureOffset;
 }
 
-boolean SCD40::setTemperatureOffset(float temperatureOffset) {
+void SCD40::applyCommands() {
+  this->stopped = false;
+  I2C::transact(SCD40_I2C_ADR, I2C_CLK, +[](SCD40* self) -> boolean {
+    SCD40Command command;
+    boolean persist = false;
+    while (xQueueReceive(self->commandQueue, &command, 0) == pdTRUE) {
+      if (self->applyCommand(command)) persist = true;
+    }
+    // one EEPROM write for the whole batch
+    if (persist) self->checkError(self->scd40->persistSettings(), "persistSettings");
+    return self->startMeasurement();
+  }, this);
+}
+
+boolean SCD40::calibrateScd40ToReference(uint16_t co2Reference, const char* id) {
+  return queueCommand(SCD40_FORCED_RECALIBRATION, co2Reference, id);
+}
+
+boolean SCD40::setTemperatureOffset(float temperatureOffset, const char* id) {
   if (temperatureOffset < 0) {
     ESP_LOGW(TAG, "Negative temperature offset not supported");
     return false;
   }
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  boolean success = checkError(scd40->stopPeriodicMeasurement(), "stopPeriodicMeasurement");
-  if (!success) {
-    I2C::giveMutex();
-    ESP_LOGD(TAG, "failed to setTemperatureOffset");
-    return false;
-  }
-  vTaskDelay(pdMS_TO_TICKS(500));
-  success = checkError(scd40->setTemperatureOffset(temperatureOffset), "setTemperatureOffset");
-  if (!success) {
-    ESP_LOGD(TAG, "failed to setTemperatureOffset");
-  } else {
-    success = checkError(scd40->persistSettings(), "persistSettings");
-    if (!success) {
-      ESP_LOGD(TAG, "failed to persist temperatureOffset");
-    }
-  }
-  ESP_LOGD(TAG, "setTemperatureOffset: %.1f", temperatureOffset);
-  success = startMeasurement();
-  I2C::giveMutex();
-  return success;
+  return queueCommand(SCD40_SET_TEMPERATURE_OFFSET, temperatureOffset, id);
+}
+
+boolean SCD40::setSensorAltitude(uint16_t altitude) {
+  if (altitude == this->settings.altitude) return true;
+  return queueCommand(SCD40_SET_ALTITUDE, altitude);
+}
+
+boolean SCD40::setAutomaticSelfCalibration(boolean enabled) {
+  if (enabled == this->settings.ascEnabled) return true;
+  return queueCommand(SCD40_SET_ASC, enabled ? 1 : 0);
+}
+
+float SCD40::getTemperatureOffset() {
+  return this->settings.temperatureOffset;
+}
+
+SCD40Settings SCD40::getSettings() {
+  return this->settings;
 }
 
 boolean SCD40::setAmbientPressure(uint16_t ambientPressureInHpa) {
   if (ambientPressureInHpa == lastAmbientPressure) return true;
   lastAmbientPressure = ambientPressureInHpa;
   ESP_LOGD(TAG, "setAmbientPressure: %u", ambientPressureInHpa);
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  boolean success = checkError(scd40->setAmbientPressure(ambientPressureInHpa), "setAmbientPressure");
+  boolean success = I2C::transact(SCD40_I2C_ADR, I2C_CLK, +[](SCD40* self) -> boolean {
+    return self->checkError(self->scd40->setAmbientPressure(self->lastAmbientPressure), "setAmbientPressure");
+  }, this);
   if (!success) {
     ESP_LOGD(TAG, "failed to setAmbientPressure");
   }
-  I2C::giveMutex();
   return success;
 }
@@ -0,0 +1,103 @@
+#include <sensorSample.h>
+#include <ArduinoJson.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+/*
+{
+  "previousBoot": true,
+  "uptime": 4294967295,
+  "co2": 65535,
+  "temperature": "-100.0",
+  "humidity": "100.0",
+  "pressure": 65535,
+  "iaq": 65535,
+  "pm0.5": 65535,
+  "pm1": 65535,
+  "pm2.5": 65535,
+  "pm4": 65535,
+  "pm10": 65535,
+  "fanPwm": 255
+}
+*/
+#define SENSOR_SAMPLE_JSON_MEMBERS 13
+
+// JSON carries temperature and humidity as strings with one decimal, the caller provides their storage
+static void toJson(const SensorSample& sample, JsonObject obj, char temperature[8], char humidity[8], SensorSampleEncoding encoding) {
+  if (sample.mask & M_CO2) obj["co2"] = sample.data.co2;
+  if ((sample.mask & M_TEMPERATURE) && encoding == SSE_MSGPACK) {
+    obj["temperature"] = roundf(sample.data.temperature * 10) / 10;
+  } else if (sample.mask & M_TEMPERATURE) {
+    snprintf(temperature, 8, "%.1f", sample.data.temperature);
+    obj["temperature"] = (const char*)temperature;
+  }
+  if ((sample.mask & M_HUMIDITY) && encoding == SSE_MSGPACK) {
+    obj["humidity"] = roundf(sample.data.humidity * 10) / 10;
+  } else if (sample.mask & M_HUMIDITY) {
+    snprintf(humidity, 8, "%.1f", sample.data.humidity);
+    obj["humidity"] = (const char*)humidity;
+  }
+  if (sample.mask & M_PRESSURE) obj["pressure"] = sample.data.pressure;
+  if (sample.mask & M_IAQ) obj["iaq"] = sample.data.iaq;
+  if (sample.mask & M_PM0_5) obj["pm0.5"] = sample.data.pm0_5;
+  if (sample.mask & M_PM1_0) obj["pm1"] = sample.data.pm1;
+  if (sample.mask & M_PM2_5) obj["pm2.5"] = sample.data.pm2_5;
+  if (sample.mask & M_PM4) obj["pm4"] = sample.data.pm4;
+  if (sample.mask & M_PM10) obj["pm10"] = sample.data.pm10;
+  obj["fanPwm"] = sample.fanPwm;
+}
+
+static size_t serialize(const JsonDocument& doc, char* buf, size_t size, SensorSampleEncoding encoding) {
+  if (encoding == SSE_MSGPACK) return serializeMsgPack(doc, buf, size);
+  return serializeJson(doc, buf, size);
+}
+
+size_t serializeSensorSample(const SensorSample& sample, char* buf, size_t size, SensorSampleEncoding encoding) {
+  StaticJsonDocument<JSON_OBJECT_SIZE(SENSOR_SAMPLE_JSON_MEMBERS)> doc;
+  char temperature[8];
+  char humidity[8];
+  toJson(sample, doc.to<JsonObject>(), temperature, humidity, encoding);
+  return serialize(doc, buf, size, encoding);
+}
+
+size_t serializeSensorSamples(const SensorSample* samples, uint8_t count, uint32_t now, char* buf, size_t size, SensorSampleEncoding encoding, boolean previousBoot) {
+  StaticJsonDocument<JSON_ARRAY_SIZE(SENSORS_BATCH_MAX) + SENSORS_BATCH_MAX * JSON_OBJECT_SIZE(SENSOR_SAMPLE_JSON_MEMBERS)> doc;
+  char temperature[SENSORS_BATCH_MAX][8];
+  char humidity[SENSORS_BATCH_MAX][8];
+  if (count > SENSORS_BATCH_MAX) return 0;
+  JsonArray array = doc.to<JsonArray>();
+  for (uint8_t i = 0; i < count; i++) {
+    JsonObject obj = array.createNestedObject();
+    if (previousBoot) {
+      obj["previousBoot"] = true;
+      obj["uptime"] = samples[i].timestamp;
+    } else {
+      obj["age"] = now - samples[i].timestamp;
+    }
+    toJson(samples[i], obj, temperature[i], humidity[i], encoding);
+  }
+  return serialize(doc, buf, size, encoding);
+}
+
+uint8_t coalesceSensorSample(SensorSample& pending, const SensorSample& newer) {
+  uint16_t overwritten = pending.mask & newer.mask;
+  if (newer.mask & M_CO2) pending.data.co2 = newer.data.co2;
+  if (newer.mask & M_TEMPERATURE) pending.data.temperature = newer.data.temperature;
+  if (newer.mask & M_HUMIDITY) pending.data.humidity = newer.data.humidity;
+  if (newer.mask & M_PRESSURE) pending.data.pressure = newer.data.pressure;
+  if (newer.mask & M_IAQ) pending.data.iaq = newer.data.iaq;
+  if (newer.mask & M_PM0_5) pending.data.pm0_5 = newer.data.pm0_5;
+  if (newer.mask & M_PM1_0) pending.data.pm1 = newer.data.pm1;
+  if (newer.mask & M_PM2_5) pending.data.pm2_5 = newer.data.pm2_5;
+  if (newer.mask & M_PM4) pending.data.pm4 = newer.data.pm4;
+  if (newer.mask & M_PM10) pending.data.pm10 = newer.data.pm10;
+  pending.mask |= newer.mask;
+  pending.fanPwm = newer.fanPwm;
+  pending.timestamp = newer.timestamp;
+  pending.data.status = newer.data.status;
+  // data.updated is kept, end to end latency counts from the oldest update still waiting
+  uint8_t count = 0;
+  for (; overwritten; overwritten &= overwritten - 1) count++;
+  return count;
+}
@@ -3,6 +3,7 @@
 #include <scd30.h>
 #include <scd40.h>
 #include <sps_30.h>
+#include <deadlineScheduler.h>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
@@ -18,9 +19,9 @@ namespace Sensors {
   SCD40* scd40;
   SPS_30* sps30;
 
-  uint32_t lastScd30Reading = 0;
-  uint32_t lastScd40Reading = 0;
-  uint32_t lastSps30Reading = 0;
+  // only touched by the sensors task once it runs
+  DeadlineScheduler scheduler;
+  int8_t scd30JobId = -1;
 
   volatile boolean loopActive = false;
 
@@ -36,9 +37,33 @@ namespace Sensors {
     sps30 = pSps30;
   }
 
+  uint32_t scd30Job(void* arg) {
+    // normally read on the data ready interrupt, this catches a missed edge
+    if (digitalRead(SCD30_RDY_PIN)) ((SCD30*)arg)->readScd30();
+    return ((SCD30*)arg)->getInterval() * 1000;
+  }
+
+  uint32_t scd40Job(void* arg) {
+    return ((SCD40*)arg)->step();
+  }
+
+  // one step of the measurement cycle per run, the warm up doesn't hold up the other sensors
+  uint32_t sps30Job(void* arg) {
+    return ((SPS_30*)arg)->step();
+  }
+
   TaskHandle_t start(const char* name, uint32_t stackSize, UBaseType_t priority, BaseType_t core) {
     _ASSERT(scd30 || scd40 || sps30);
     loopActive = true;
+    // first reads straight away, the SPS30 a little later so the reads don't share a wakeup
+    uint32_t now = millis();
+    if (scd40) scheduler.add("scd40", scd40Job, scd40, scd40->getInterval() * 1000, 0, 0, now);
+    if (sps30) scheduler.add("sps30", sps30Job, sps30, sps30->getInterval() * 1000, SENSORS_PHASE_MS, 0, now);
+    if (scd30) {
+      scd30JobId = scheduler.add("scd30", scd30Job, scd30, scd30->getInterval() * 1000, 0, 0, now);
+      pinMode(SCD30_RDY_PIN, INPUT);
+      attachInterrupt(SCD30_RDY_PIN, measurementReady, RISING);
+    }
     xTaskCreatePinnedToCore(
       sensorsLoop,  // task function
       name,         // name of task
@@ -47,13 +72,6 @@ namespace Sensors {
       priority,     // priority of the task
       &sensorsTask, // task handle
       core);        // CPU core
-    if (scd40) lastScd40Reading = millis() - (uint32_t)(scd40->getInterval() * 1000);
-    if (sps30) lastSps30Reading = millis() - (uint32_t)(sps30->getInterval() * 1000);
-    if (scd30) {
-      lastScd30Reading = millis() - (uint32_t)(scd30->getInterval() * 1000);
-      pinMode(SCD30_RDY_PIN, INPUT);
-      attachInterrupt(SCD30_RDY_PIN, measurementReady, RISING);
-    }
     return sensorsTask;
   }
 
@@ -78,59 +96,19 @@ namespace Sensors {
   void sensorsLoop(void* pvParameters) {
     _ASSERT((uint32_t)pvParameters == 1);
     uint32_t taskNotification;
-    BaseType_t notified;
-    uint32_t now;
-    // try a read straight away to see if data is ready
-    if (scd40) scd40->readScd40();
-    if (scd30) scd30->readScd30();
-    if (sps30) sps30->readSps30();
     while (loopActive) {
-      if (scd40 && (millis() - lastScd40Reading > (uint32_t)(scd40->getInterval() * 1000))) {
-        lastScd40Reading += (uint32_t)(scd40->getInterval() * 1000);
-        scd40->readScd40();
-      }
-      if (sps30 && (millis() - lastSps30Reading > (uint32_t)(sps30->getInterval() * 1000))) {
-        lastSps30Reading += (uint32_t)(sps30->getInterval() * 1000);
-        sps30->readSps30();
+      uint32_t wait = scheduler.runDue(millis());
+      BaseType_t notified = xTaskNotifyWait(0x00,  // Don't clear any bits on entry
+        ULONG_MAX,                                 // Clear all bits on exit
+        &taskNotification,                         // Receives the notification value
+        wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait));
+      if (notified != pdPASS) continue;
+      if (scd30 && taskNotification & X_CMD_SCD30_DATA_READY) {
+        scd30->readScd30();
+        scheduler.ranAt(scd30JobId, millis());
       }
-
-      now = millis();
-      uint32_t delay = 0xffffffff;
-      if (scd40) {
-        uint32_t nextScd40 = (uint32_t)(scd40->getInterval() * 1000) - (now - lastScd40Reading);
-        if (nextScd40 > (uint32_t)(scd40->getInterval() * 1000)) nextScd40 = 0;
-        delay = min(delay, nextScd40);
-      }
-      if (scd30) {
-        uint32_t nextScd30 = (uint32_t)(scd30->getInterval() * 1000) - (now - lastScd30Reading);
-        if (nextScd30 > (uint32_t)(scd30->getInterval() * 1000)) nextScd30 = 0;
-        delay = min(delay, nextScd30);
-      }
-      if (sps30) {
-        uint32_t nextSps30 = (uint32_t)(sps30->getInterval() * 1000) - (now - lastSps30Reading);
-        if (nextSps30 > (uint32_t)(sps30->getInterval() * 1000)) nextSps30 = 0;
-        delay = min(delay, nextSps30);
-      }
-
-      notified = xTaskNotifyWait(0x00,  // Don't clear any bits on entry
-        ULONG_MAX,                      // Clear all bits on exit
-        &taskNotification,              // Receives the notification value
-        pdMS_TO_TICKS(delay));
-      if (notified == pdPASS) {
-        if (scd30 && taskNotification & X_CMD_SCD30_DATA_READY) {
-          taskNotification &= ~X_CMD_SCD30_DATA_READY;
-          scd30->readScd30();
-          lastScd30Reading += (uint32_t)(scd30->getInterval() * 1000);
-        }
-        if (taskNotification & X_CMD_SHUTDOWN) {
-          taskNotification &= ~X_CMD_SHUTDOWN;
-          loopActive = false;
-        }
-      } else {
-        if (scd30 && digitalRead(SCD30_RDY_PIN)) {
-          scd30->readScd30();
-          lastScd30Reading += scd30->getInterval() * 1000;
-        }
+      if (taskNotification & X_CMD_SHUTDOWN) {
+        loopActive = false;
       }
     }
     vTaskDelete(NULL);
@@ -5,6 +5,7 @@
 
 #include <i2c.h>
 #include <configManager.h>
+#include <latency.h>
 
 // Local logging tag
 static const char TAG[] = __FILE__;
@@ -14,55 +15,58 @@ static const char TAG[] = __FILE__;
 boolean SPS_30::checkError(uint16_t error, char const* msg) {
   if (error != SPS30_ERR_OK) {
     ESP_LOGW(TAG, "Error trying to execute %s: %x", msg, error);
-    I2C::giveMutex();
 #ifdef SHOW_DEBUG_MSGS
     this->updateMessageCallback("error SPS30 cmd");
 #endif
-    while (!I2C::takeMutex(portMAX_DELAY));
     return false;
   }
   return true;
 }
 
-SPS_30::SPS_30(TwoWire* wire, Model* _model, updateMessageCallback_t _updateMessageCallback) {
+SPS_30::SPS_30(TwoWire* wire, Model* _model, updateMessageCallback_t _updateMessageCallback, publishMessageCallback_t _publishMessageCallback) {
   this->model = _model;
   this->updateMessageCallback = _updateMessageCallback;
+  this->publishMessageCallback = _publishMessageCallback;
   this->sps30 = new SPS30();
   ESP_LOGD(TAG, "Initialising SPS30");
 
   //  sps30->EnableDebugging(2);
 
-  if (!I2C::takeMutex(portMAX_DELAY)) return;
-
-  if (sps30->begin(wire) == false) {
-    ESP_LOGD(TAG, "Could not initialise SPS30!");
-    I2C::giveMutex();
-#ifdef SHOW_DEBUG_MSGS
-    this->updateMessageCallback("SPS30 fail");
-#endif
-    return;
-  }
-  if (!sps30->probe()) {
-    ESP_LOGD(TAG, "Could not probe SPS30!");
-    I2C::giveMutex();
+  struct Init {
+    SPS30* sps30;
+    TwoWire* wire;
+  } init = { this->sps30, wire };
+  boolean success = I2C::transact(SPS30_I2C_ADR, I2C_CLK, +[](Init* init) -> boolean {
+    SPS30* sps30 = init->sps30;
+    if (sps30->begin(init->wire) == false) {
+      ESP_LOGD(TAG, "Could not initialise SPS30!");
+      return false;
+    }
+    if (!sps30->probe()) {
+      ESP_LOGD(TAG, "Could not probe SPS30!");
+      return false;
+    }
+    SPS30_version version;
+    if (sps30->GetVersion(&version) == SPS30_ERR_OK) {
+      ESP_LOGD(TAG, "SPS30 version: %u.%u", version.major, version.minor);
+    } else {
+      ESP_LOGI(TAG, "Could not get SPS30 version!");
+    }
+    uint32_t autoCleanInterval = 0;
+    if (sps30->GetAutoCleanInt(&autoCleanInterval) == SPS30_ERR_OK) {
+      ESP_LOGD(TAG, "SPS30 auto clean interval: %u days %u hours %u minutes %u seconds (%u)", autoCleanInterval / 60 / 60 / 24, autoCleanInterval / 60 / 60 % 24, autoCleanInterval / 60 % 60, autoCleanInterval % 60, autoCleanInterval);
+    } else {
+      ESP_LOGI(TAG, "Could not get auto clean interval!");
+    }
+    return true;
+  }, &init);
+  if (!success) {
 #ifdef SHOW_DEBUG_MSGS
     this->updateMessageCallback("SPS30 fail");
 #endif
     return;
   }
-  SPS30_version version;
-  if (sps30->GetVersion(&version) == SPS30_ERR_OK) {
-    ESP_LOGD(TAG, "SPS30 version: %u.%u", version.major, version.minor);
-  } else {
-    ESP_LOGI(TAG, "Could not get SPS30 version!");
-  }
-  uint32_t autoCleanInterval = 0;
-  if (sps30->GetAutoCleanInt(&autoCleanInterval) == SPS30_ERR_OK) {
-    ESP_LOGD(TAG, "SPS30 auto clean interval: %u days %u hours %u minutes %u seconds (%u)", autoCleanInterval / 60 / 60 / 24, autoCleanInterval / 60 / 60 % 24, autoCleanInterval / 60 % 60, autoCleanInterval % 60, autoCleanInterval);
-  } else {
-    ESP_LOGI(TAG, "Could not get auto clean interval!");
-  }
-  I2C::giveMutex();
+  this->initialised = true;
   ESP_LOGD(TAG, "SPS30 initialised");
 }
 
@@ -74,112 +78,156 @@ uint32_t SPS_30::getInterval() {
   return 60;
 }
 
+uint32_t SPS_30::step() {
+  uint32_t wait;
+  switch (this->state) {
+    case SPS30_IDLE:
+      this->cycleMs = 0;
+      wait = startMeasurement();
+      break;
+    case SPS30_CLEANING:
+      this->publishMessageCallback("SPS30 fan clean done");
+      this->state = SPS30_WARMING_UP;
+      wait = SPS30_WARMUP_MS;
+      break;
+    default:
+      wait = readAndStop();
+      break;
+  }
+  this->cycleMs += wait;
+  return wait;
+}
+
 boolean SPS_30::readSps30() {
-  //  ESP_LOGD(TAG, "readSps30");
+  do {
+    uint32_t wait = step();
+    if (this->state != SPS30_IDLE) delay(wait);
+  } while (this->state != SPS30_IDLE);
+  return this->lastReadOk;
+}
+
+uint32_t SPS_30::startMeasurement() {
 #ifdef SHOW_DEBUG_MSGS
   this->updateMessageCallback("readSps30");
 #endif
-  struct sps_values values;
-
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  if (!sps30->start()) {
+  // clean requests that come in meanwhile wait for the next cycle
+  struct Start {
+    SPS30* sps30;
+    boolean clean;
+    boolean cleaning;
+  } start = { sps30, this->cleanRequested, false };
+  this->cleanRequested = false;
+  boolean started = I2C::transact(SPS30_I2C_ADR, I2C_CLK, +[](Start* start) -> boolean {
+    if (!start->sps30->start()) return false;
+    if (start->clean) start->cleaning = start->sps30->clean();
+    return true;
+  }, &start);
+  if (!started) {
     ESP_LOGD(TAG, "Could not start SPS30!");
-    I2C::giveMutex();
+    if (start.clean) this->cleanRequested = true;
 #ifdef SHOW_DEBUG_MSGS
     this->updateMessageCallback("SPS30 start fail");
 #endif
-    return false;
+    return getInterval() * 1000;
   }
-
-  I2C::giveMutex();
-  delay(5000);
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-
-  uint8_t result = SPS30_ERR_TIMEOUT;
-  for (int i = 0;i < 3 && result == SPS30_ERR_TIMEOUT;i++) {
-    result = sps30->GetValues(&values);
+  if (start.cleaning) {
+    this->state = SPS30_CLEANING;
+    return SPS30_CLEAN_MS;
   }
+  if (start.clean) {
+    ESP_LOGW(TAG, "Could not clean SPS30!");
+    this->publishMessageCallback("SPS30 fan clean failed");
+  }
+  this->state = SPS30_WARMING_UP;
+  return SPS30_WARMUP_MS;
+}
 
-  if (!sps30->stop()) {
+uint32_t SPS_30::readAndStop() {
+  uint32_t rest = getInterval() * 1000 > this->cycleMs ? getInterval() * 1000 - this->cycleMs : SPS30_WARMUP_MS;
+  this->state = SPS30_IDLE;
+  this->lastReadOk = false;
+  struct Read {
+    SPS30* sps30;
+    struct sps_values values;
+    uint8_t result;
+  } read;
+  read.sps30 = sps30;
+  read.result = SPS30_ERR_TIMEOUT;
+  boolean stopped = I2C::transact(SPS30_I2C_ADR, I2C_CLK, +[](Read* read) -> boolean {
+    uint32_t start = Latency::now();
+    for (int i = 0;i < 3 && read->result == SPS30_ERR_TIMEOUT;i++) {
+      read->result = read->sps30->GetValues(&read->values);
+    }
+    if (read->result == SPS30_ERR_OK) Latency::recordSince(LS_SENSOR_READ, start);
+    return read->sps30->stop();
+  }, &read);
+
+  if (!stopped) {
     ESP_LOGD(TAG, "Could not stop SPS30!");
-    I2C::giveMutex();
 #ifdef SHOW_DEBUG_MSGS
     this->updateMessageCallback("SPS30 stop fail");
 #endif
-    return false;
+    return rest;
   }
 
-  I2C::giveMutex();
 #ifdef SHOW_DEBUG_MSGS
   this->updateMessageCallback("");
 #endif
+  uint8_t result = read.result;
+  struct sps_values& values = read.values;
   if (result == SPS30_ERR_OK) {
     ESP_LOGD(TAG, "SPS30 MassPM1:%.1f, MassPM2:%.1f, MassPM4:%.1f, MassPM10:%.1f, NumPM0:%.1f, NumPM1:%.1f, NumPM2:%.1f, NumPM4:%.1f, NumPM10:%.1f, PartSize:%.1f",
       values.MassPM1, values.MassPM2, values.MassPM4, values.MassPM10, values.NumPM0, values.NumPM1, values.NumPM2, values.NumPM4, values.NumPM10, values.PartSize);
     model->updateModel((uint16_t)(values.NumPM0 + 0.5f), (uint16_t)(values.NumPM1 + 0.5f), (uint16_t)(values.NumPM2 + 0.5f), (uint16_t)(values.NumPM4 + 0.5f), (uint16_t)(values.NumPM10 + 0.5f));
+    this->lastReadOk = true;
   }
-  //  ESP_LOGD(TAG, "Sps30 done");
-  return (result == SPS30_ERR_OK);
+  return rest;
 }
 
+// a register to write or read, for the transactions
+struct Sps30Value {
+  SPS30* sps30;
+  uint32_t value;
+};
+
 uint8_t SPS_30::getStatus() {
   ESP_LOGD(TAG, "getStatus");
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return 0xff;
-  uint8_t value = 0;
-  uint8_t result = sps30->GetStatusReg(&value);
-  I2C::giveMutex();
-  if (result != SPS30_ERR_OK) return 0xff;
-  return value;
+  Sps30Value status = { sps30, 0xff };
+  I2C::transact(SPS30_I2C_ADR, I2C_CLK, +[](Sps30Value* status) -> boolean {
+    uint8_t value = 0;
+    if (status->sps30->GetStatusReg(&value) != SPS30_ERR_OK) return false;
+    status->value = value;
+    return true;
+  }, &status);
+  return (uint8_t)status.value;
 }
 
 uint32_t SPS_30::getAutoCleanInterval() {
   ESP_LOGD(TAG, "getAutoCleanInterval");
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return 0xffffffff;
-  uint32_t value = 0;
-  uint8_t result = sps30->GetAutoCleanInt(&value);
-  I2C::giveMutex();
-  if (result != SPS30_ERR_OK) return 0xffffffff;
-  return value;
+  Sps30Value interval = { sps30, 0xffffffff };
+  I2C::transact(SPS30_I2C_ADR, I2C_CLK, +[](Sps30Value* interval) -> boolean {
+    uint32_t value = 0;
+    if (interval->sps30->GetAutoCleanInt(&value) != SPS30_ERR_OK) return false;
+    interval->value = value;
+    return true;
+  }, &interval);
+  return interval.value;
 }
 
 boolean SPS_30::setAutoCleanInterval(uint32_t intervalInSeconds) {
   ESP_LOGD(TAG, "setAutoCleanInterval %u", intervalInSeconds);
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  uint8_t result = sps30->SetAutoCleanInt(intervalInSeconds);
-  I2C::giveMutex();
-  return (result == SPS30_ERR_OK);
+  Sps30Value interval = { sps30, intervalInSeconds };
+  return I2C::transact(SPS30_I2C_ADR, I2C_CLK, +[](Sps30Value* interval) -> boolean {
+    return interval->sps30->SetAutoCleanInt(interval->value) == SPS30_ERR_OK;
+  }, &interval);
 }
 
 boolean SPS_30::clean() {
   ESP_LOGD(TAG, "clean");
+  if (!this->initialised) return false;
 #ifdef SHOW_DEBUG_MSGS
   this->updateMessageCallback("clean sps30");
 #endif
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-
-  if (!sps30->start()) {
-    ESP_LOGD(TAG, "Could not start SPS30!");
-    I2C::giveMutex();
-#ifdef SHOW_DEBUG_MSGS
-    this->updateMessageCallback("SPS30 start fail");
-#endif
-    return false;
-  }
-  I2C::giveMutex();
-  delay(5000);
-  if (!I2C::takeMutex(I2C_MUTEX_DEF_WAIT)) return false;
-  boolean result = sps30->clean();
-  if (!sps30->stop()) {
-    ESP_LOGD(TAG, "Could not stop SPS30!");
-    I2C::giveMutex();
-#ifdef SHOW_DEBUG_MSGS
-    this->updateMessageCallback("SPS30 stop fail");
-#endif
-    return false;
-  }
-  I2C::giveMutex();
-#ifdef SHOW_DEBUG_MSGS
-  this->updateMessageCallback("");
-#endif
-  return result;
+  this->cleanRequested = true;
+  return true;
 }
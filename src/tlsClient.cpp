@@ -0,0 +1,372 @@
+#include <tlsClient.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <mbedtls/error.h>
+#include <mbedtls/net_sockets.h>
+
+// Local logging tag
+static const char TAG[] = __FILE__;
+
+static const char TLS_PERSONALISATION[] = "crbox-tls";
+
+TlsCredentials::TlsCredentials() {
+  mbedtls_x509_crt_init(&this->rootCa);
+  mbedtls_x509_crt_init(&this->clientCert);
+  mbedtls_pk_init(&this->clientKey);
+  this->rootCaLoaded = false;
+  this->clientCertLoaded = false;
+}
+
+TlsCredentials::~TlsCredentials() {
+  mbedtls_x509_crt_free(&this->rootCa);
+  mbedtls_x509_crt_free(&this->clientCert);
+  mbedtls_pk_free(&this->clientKey);
+}
+
+unsigned char* TlsCredentials::readFile(const char* filename, size_t* length) {
+  if (!LittleFS.exists(filename)) return NULL;
+  File file = LittleFS.open(filename, FILE_READ);
+  if (!file) return NULL;
+  *length = file.size();
+  unsigned char* buf = (unsigned char*)malloc(*length + 1);
+  if (buf && file.read(buf, *length) != *length) {
+    free(buf);
+    buf = NULL;
+  }
+  file.close();
+  if (buf) buf[*length] = 0x00;
+  return buf;
+}
+
+boolean TlsCredentials::load(const char* rootCaFilename, const char* clientKeyFilename, const char* clientCertFilename) {
+  size_t length;
+  int ret;
+  unsigned char* pem;
+  // PEM input has to include the terminating zero in its length
+  if ((pem = readFile(rootCaFilename, &length)) != NULL) {
+    ESP_LOGD(TAG, "Parsing root ca from FS (%s)", rootCaFilename);
+    ret = mbedtls_x509_crt_parse(&this->rootCa, pem, length + 1);
+    free(pem);
+    if (ret != 0) {
+      ESP_LOGW(TAG, "Failed to parse %s: -0x%04x", rootCaFilename, -ret);
+      return false;
+    }
+    this->rootCaLoaded = true;
+  }
+  if ((pem = readFile(clientCertFilename, &length)) != NULL) {
+    ESP_LOGD(TAG, "Parsing client cert from FS (%s)", clientCertFilename);
+    ret = mbedtls_x509_crt_parse(&this->clientCert, pem, length + 1);
+    free(pem);
+    if (ret != 0) {
+      ESP_LOGW(TAG, "Failed to parse %s: -0x%04x", clientCertFilename, -ret);
+      return false;
+    }
+    if ((pem = readFile(clientKeyFilename, &length)) == NULL) {
+      ESP_LOGW(TAG, "Client cert without key (%s)", clientKeyFilename);
+      return false;
+    }
+    ESP_LOGD(TAG, "Parsing client key from FS (%s)", clientKeyFilename);
+    ret = mbedtls_pk_parse_key(&this->clientKey, pem, length + 1, NULL, 0);
+    free(pem);
+    if (ret != 0) {
+      ESP_LOGW(TAG, "Failed to parse %s: -0x%04x", clientKeyFilename, -ret);
+      return false;
+    }
+    this->clientCertLoaded = true;
+  }
+  return true;
+}
+
+boolean TlsCredentials::hasRootCa() {
+  return this->rootCaLoaded;
+}
+
+boolean TlsCredentials::hasClientCert() {
+  return this->clientCertLoaded;
+}
+
+TlsClient::TlsClient(TlsCredentials* credentials, boolean insecure) {
+  this->credentials = credentials;
+  this->insecure = insecure;
+  this->socket = -1;
+  this->configured = false;
+  this->sslConnected = false;
+  this->peeked = -1;
+  this->sessionSaved = false;
+  this->handshakeMs = 0;
+  this->resumed = false;
+  mbedtls_entropy_init(&this->entropy);
+  mbedtls_ctr_drbg_init(&this->ctrDrbg);
+  mbedtls_ssl_config_init(&this->conf);
+  mbedtls_ssl_init(&this->ssl);
+  mbedtls_ssl_session_init(&this->session);
+}
+
+TlsClient::~TlsClient() {
+  stop();
+  mbedtls_ssl_session_free(&this->session);
+  mbedtls_ssl_free(&this->ssl);
+  mbedtls_ssl_config_free(&this->conf);
+  mbedtls_ctr_drbg_free(&this->ctrDrbg);
+  mbedtls_entropy_free(&this->entropy);
+}
+
+void TlsClient::logError(const char* what, int ret) {
+  char buf[100];
+  mbedtls_strerror(ret, buf, sizeof(buf));
+  ESP_LOGW(TAG, "%s failed: -0x%04x %s", what, -ret, buf);
+}
+
+boolean TlsClient::setupConfig() {
+  if (this->configured) return true;
+  int ret = mbedtls_ctr_drbg_seed(&this->ctrDrbg, mbedtls_entropy_func, &this->entropy,
+    (const unsigned char*)TLS_PERSONALISATION, sizeof(TLS_PERSONALISATION) - 1);
+  if (ret != 0) {
+    logError("mbedtls_ctr_drbg_seed", ret);
+    return false;
+  }
+  ret = mbedtls_ssl_config_defaults(&this->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if (ret != 0) {
+    logError("mbedtls_ssl_config_defaults", ret);
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&this->conf, mbedtls_ctr_drbg_random, &this->ctrDrbg);
+  if (this->insecure) {
+    mbedtls_ssl_conf_authmode(&this->conf, MBEDTLS_SSL_VERIFY_NONE);
+  } else if (this->credentials && this->credentials->hasRootCa()) {
+    mbedtls_ssl_conf_authmode(&this->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&this->conf, &this->credentials->rootCa, NULL);
+  } else {
+    ESP_LOGW(TAG, "No root ca to verify the server with");
+    return false;
+  }
+  if (this->credentials && this->credentials->hasClientCert()) {
+    ret = mbedtls_ssl_conf_own_cert(&this->conf, &this->credentials->clientCert, &this->credentials->clientKey);
+    if (ret != 0) {
+      logError("mbedtls_ssl_conf_own_cert", ret);
+      return false;
+    }
+  }
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&this->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+  this->configured = true;
+  return true;
+}
+
+int TlsClient::bioSend(void* ctx, const unsigned char* buf, size_t length) {
+  int ret = send(*(int*)ctx, buf, length, 0);
+  if (ret >= 0) return ret;
+  return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int TlsClient::bioRecv(void* ctx, unsigned char* buf, size_t length) {
+  int ret = recv(*(int*)ctx, buf, length, 0);
+  if (ret > 0) return ret;
+  if (ret == 0) return MBEDTLS_ERR_NET_CONN_RESET;
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+// non blocking connect bounded by TLS_CONNECT_TIMEOUT_MS, the socket stays non blocking
+boolean TlsClient::openSocket(IPAddress ip, uint16_t port) {
+  this->socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (this->socket < 0) {
+    ESP_LOGW(TAG, "socket failed: %d", errno);
+    return false;
+  }
+  fcntl(this->socket, F_SETFL, fcntl(this->socket, F_GETFL, 0) | O_NONBLOCK);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = (uint32_t)ip;
+  address.sin_port = htons(port);
+  if (::connect(this->socket, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+    ESP_LOGW(TAG, "connect failed: %d", errno);
+    return false;
+  }
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(this->socket, &writeSet);
+  struct timeval timeout = { TLS_CONNECT_TIMEOUT_MS / 1000, (TLS_CONNECT_TIMEOUT_MS % 1000) * 1000 };
+  if (select(this->socket + 1, NULL, &writeSet, NULL, &timeout) <= 0) {
+    ESP_LOGW(TAG, "connect timed out");
+    return false;
+  }
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(this->socket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+    ESP_LOGW(TAG, "connect failed: %d", error);
+    return false;
+  }
+  int enable = 1;
+  setsockopt(this->socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  return true;
+}
+
+int TlsClient::connect(const char* host, IPAddress ip, uint16_t port) {
+  stop();
+  if (!setupConfig() || !openSocket(ip, port)) {
+    stop();
+    return 0;
+  }
+  int ret = mbedtls_ssl_setup(&this->ssl, &this->conf);
+  if (ret == 0 && host) ret = mbedtls_ssl_set_hostname(&this->ssl, host);
+  if (ret == 0 && this->sessionSaved) ret = mbedtls_ssl_set_session(&this->ssl, &this->session);
+  if (ret != 0) {
+    logError("ssl setup", ret);
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&this->ssl, &this->socket, bioSend, bioRecv, NULL);
+  uint32_t start = millis();
+  while ((ret = mbedtls_ssl_handshake(&this->ssl)) != 0) {
+    if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) || millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+      logError("mbedtls_ssl_handshake", ret);
+      // don't offer a session the server may have choked on again
+      forgetSession();
+      stop();
+      return 0;
+    }
+    vTaskDelay(pdMS_TO_TICKS(2));
+  }
+  this->handshakeMs = millis() - start;
+  saveSession();
+  this->sslConnected = true;
+  ESP_LOGI(TAG, "TLS handshake with %s took %u ms (%s, %s)", host ? host : ip.toString().c_str(), this->handshakeMs,
+    this->resumed ? "resumed" : "full", mbedtls_ssl_get_ciphersuite(&this->ssl));
+  return 1;
+}
+
+// a resumed session keeps its master secret, a full handshake derives a new one. The session id
+// can't tell them apart, mbedTLS sends a fresh random id along with a ticket.
+void TlsClient::saveSession() {
+  boolean offered = this->sessionSaved;
+  mbedtls_ssl_session_free(&this->session);
+  mbedtls_ssl_session_init(&this->session);
+  this->sessionSaved = mbedtls_ssl_get_session(&this->ssl, &this->session) == 0;
+  this->resumed = offered && this->sessionSaved && memcmp(this->session.master, this->sessionMaster, sizeof(this->sessionMaster)) == 0;
+  if (this->sessionSaved) memcpy(this->sessionMaster, this->session.master, sizeof(this->sessionMaster));
+}
+
+void TlsClient::forgetSession() {
+  mbedtls_ssl_session_free(&this->session);
+  mbedtls_ssl_session_init(&this->session);
+  this->sessionSaved = false;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(NULL, ip, port);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    ESP_LOGW(TAG, "Failed to resolve %s", host);
+    return 0;
+  }
+  return connect(host, ip, port);
+}
+
+size_t TlsClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  if (!this->sslConnected) return 0;
+  size_t written = 0;
+  uint32_t start = millis();
+  while (written < size) {
+    int ret = mbedtls_ssl_write(&this->ssl, buf + written, size - written);
+    if (ret > 0) {
+      written += ret;
+    } else if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) || millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+      logError("mbedtls_ssl_write", ret);
+      stop();
+      break;
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(2));
+    }
+  }
+  return written;
+}
+
+int TlsClient::available() {
+  if (!this->sslConnected) return 0;
+  if (this->peeked >= 0) return 1 + mbedtls_ssl_get_bytes_avail(&this->ssl);
+  // processes pending records without consuming application data
+  int ret = mbedtls_ssl_read(&this->ssl, NULL, 0);
+  if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) logError("mbedtls_ssl_read", ret);
+    stop();
+    return 0;
+  }
+  return mbedtls_ssl_get_bytes_avail(&this->ssl);
+}
+
+int TlsClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  if (!this->sslConnected || size == 0) return -1;
+  size_t offset = 0;
+  if (this->peeked >= 0) {
+    buf[offset++] = (uint8_t)this->peeked;
+    this->peeked = -1;
+    if (size == 1 || mbedtls_ssl_get_bytes_avail(&this->ssl) == 0) return offset;
+  }
+  int ret = mbedtls_ssl_read(&this->ssl, buf + offset, size - offset);
+  if (ret > 0) return offset + ret;
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    if (ret != 0 && ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) logError("mbedtls_ssl_read", ret);
+    stop();
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+int TlsClient::peek() {
+  if (this->peeked >= 0) return this->peeked;
+  uint8_t b;
+  if (read(&b, 1) != 1) return -1;
+  this->peeked = b;
+  return b;
+}
+
+void TlsClient::flush() {
+}
+
+void TlsClient::stop() {
+  if (this->sslConnected) mbedtls_ssl_close_notify(&this->ssl);
+  this->sslConnected = false;
+  this->peeked = -1;
+  if (this->socket >= 0) {
+    close(this->socket);
+    this->socket = -1;
+  }
+  // frees the record buffers, the configuration and the saved session are kept
+  mbedtls_ssl_free(&this->ssl);
+  mbedtls_ssl_init(&this->ssl);
+}
+
+uint8_t TlsClient::connected() {
+  if (this->sslConnected) available();
+  return this->sslConnected;
+}
+
+TlsClient::operator bool() {
+  return connected();
+}
+
+int TlsClient::fd() {
+  return this->socket;
+}
+
+uint32_t TlsClient::getHandshakeMs() {
+  return this->handshakeMs;
+}
+
+boolean TlsClient::isResumed() {
+  return this->resumed;
+}